@@ -0,0 +1,96 @@
+#!/bin/sh
+# Builds a release gebaard with link time and profile guided optimization,
+# trained by replaying recorded traces, and compares it with a Release build
+# without them.
+#
+#   cmake/pgo-build.sh [TRACE_DIR [BUILD_DIR]]
+#
+# TRACE_DIR (default test/traces) holds *.trace files written on SIGUSR1,
+# directly or in subdirectories, each directory with the gebaard.toml its
+# traces were recorded with. Replays run no commands, so training goes
+# through the recognizers and command dispatch without spawning anything.
+# Every second trace in name order is held out of training and the speed of
+# both builds is measured on those.
+
+set -e
+
+source_dir=$(cd "$(dirname "$0")/.." && pwd)
+trace_dir=$(cd "${1:-$source_dir/test/traces}" && pwd)
+build_dir=${2:-$source_dir/build-pgo}
+jobs=$(nproc 2>/dev/null || echo 2)
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+find "$trace_dir" -name '*.trace' | sort >"$tmp/all"
+if [ ! -s "$tmp/all" ]; then
+  echo "no traces in $trace_dir" >&2
+  exit 1
+fi
+awk 'NR % 2 == 1' "$tmp/all" >"$tmp/training"
+awk 'NR % 2 == 0' "$tmp/all" >"$tmp/held-out"
+if [ ! -s "$tmp/held-out" ]; then
+  echo "warning: a single trace, measuring on the one trained with" >&2
+  cp "$tmp/training" "$tmp/held-out"
+fi
+
+# Replays read gebaard.toml from XDG_CONFIG_HOME and cache it next to it, so
+# each directory of traces gets its own
+config_home() {
+  dir=$(dirname "$1")
+  home=$tmp/config$(echo "$dir" | tr / _)
+  if [ ! -d "$home" ]; then
+    mkdir -p "$home/gebaar"
+    if [ -f "$dir/gebaard.toml" ]; then
+      cp "$dir/gebaard.toml" "$home/gebaar/"
+    fi
+  fi
+  echo "$home"
+}
+
+build() {
+  dir=$build_dir/$1
+  shift
+  cmake -S "$source_dir" -B "$dir" -DCMAKE_BUILD_TYPE=Release "$@" >/dev/null
+  cmake --build "$dir" -j"$jobs" --clean-first >/dev/null
+}
+
+# Prints the events replayed and the nanoseconds they took, over the traces
+# listed in a file
+replay() {
+  while read -r trace; do
+    if ! XDG_CONFIG_HOME=$(config_home "$trace") "$1" --replay "$trace" \
+      --budget 1000000 >"$tmp/replay.log" 2>&1; then
+      echo "warning: $(basename "$trace") did not replay as recorded" >&2
+    fi
+    grep -o '[0-9]* events in [0-9]* ns' "$tmp/replay.log" || true
+  done <"$2" | awk '{ events += $1; ns += $4 } END { print events, ns }'
+}
+
+report() {
+  stripped="$tmp/gebaard-$1"
+  strip -o "$stripped" "$build_dir/$1/gebaard"
+  replay "$build_dir/$1/gebaard" "$tmp/held-out" | {
+    read -r events ns
+    echo "$1: $((events * 1000000000 / (ns > 0 ? ns : 1))) events/s" \
+      "on $(wc -l <"$tmp/held-out") held out traces," \
+      "$(wc -c <"$stripped") bytes stripped"
+  }
+}
+
+# GCC names profiles after the object files, so the release build is trained
+# and rebuilt in the same directory
+rm -rf "$build_dir/pgo"
+build default
+build release -DGEBAAR_LTO=OFF -DGEBAAR_PGO=GENERATE \
+  -DGEBAAR_PGO_DIR="$build_dir/pgo"
+replay "$build_dir/release/gebaard" "$tmp/training" >/dev/null
+if ls "$build_dir/pgo"/*.profraw >/dev/null 2>&1; then
+  llvm-profdata merge -o "$build_dir/pgo/default.profdata" \
+    "$build_dir/pgo"/*.profraw
+fi
+build release -DGEBAAR_LTO=ON -DGEBAAR_PGO=USE -DGEBAAR_PGO_DIR="$build_dir/pgo"
+
+report default
+report release
+echo "release build: $build_dir/release/gebaard"
@@ -0,0 +1,239 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config/cache.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+
+/**
+ * Fill header with the identity of a file
+ *
+ * @param st status of the file
+ * @param header receives device, inode, mtime and size
+ */
+static void describe_status(const struct stat& st,
+                            gebaar::config::cache_header* header) {
+  header->magic = CONFIG_CACHE_MAGIC;
+  header->version = CONFIG_CACHE_VERSION;
+  header->device = st.st_dev;
+  header->inode = st.st_ino;
+  header->mtime_sec = st.st_mtim.tv_sec;
+  header->mtime_nsec = st.st_mtim.tv_nsec;
+  header->size = st.st_size;
+}
+
+/**
+ * Fill header with the identity of the file at path, without reading it
+ *
+ * @param path file to describe
+ * @param header receives device, inode, mtime and size
+ * @return bool false if there is no file at path
+ */
+bool gebaar::config::describe_file(const std::string& path,
+                                   cache_header* header) {
+  struct stat st {};
+  if (stat(path.c_str(), &st) < 0) {
+    return false;
+  }
+  describe_status(st, header);
+  return true;
+}
+
+/**
+ * Read a file of another user as root. A symlink at path, a file owned by
+ * someone else or anything but a regular file is refused, so the user can't
+ * point gebaard at files only root may read.
+ *
+ * @param path file to read
+ * @param owner uid the file must belong to
+ * @param header receives device, inode, mtime and size
+ * @param contents receives the file, unless nullptr, so checking a snapshot
+ * against it only takes an fstat
+ * @return bool false if the file was refused or could not be read
+ */
+bool gebaar::config::read_owned_file(const std::string& path, uid_t owner,
+                                     cache_header* header,
+                                     std::string* contents) {
+  // O_NONBLOCK so a FIFO doesn't block the open, it is refused below
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW | O_NONBLOCK);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st {};
+  bool described =
+      fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_uid == owner;
+  if (described) {
+    describe_status(st, header);
+  }
+  if (described && contents != nullptr && st.st_size > 0) {
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+      described = false;
+    } else {
+      contents->assign(static_cast<const char*>(map), st.st_size);
+      munmap(map, st.st_size);
+    }
+  }
+  close(fd);
+  return described;
+}
+
+void gebaar::config::CacheWriter::put(uint64_t value) {
+  buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void gebaar::config::CacheWriter::put(double value) {
+  buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void gebaar::config::CacheWriter::put(bool value) {
+  buffer.push_back(value ? 1 : 0);
+}
+
+void gebaar::config::CacheWriter::put(const std::string& value) {
+  put(static_cast<uint64_t>(value.size()));
+  buffer.append(value);
+}
+
+/**
+ * Write header and buffer to a temporary file and rename it over path,
+ * so a reader never sees a half written snapshot. Like the reader, never
+ * follows a symlink put in place of the snapshot.
+ *
+ * @return bool
+ */
+bool gebaar::config::CacheWriter::write(const std::string& path,
+                                        const cache_header& header) {
+  std::string temp_path = path + ".tmp";
+  int fd = open(temp_path.c_str(),
+                O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_NOFOLLOW, 0644);
+  FILE* file = fd < 0 ? nullptr : fdopen(fd, "wb");
+  if (file == nullptr) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    return false;
+  }
+  bool written =
+      fwrite(&header, sizeof(header), 1, file) == 1 &&
+      (buffer.empty() ||
+       fwrite(buffer.data(), buffer.size(), 1, file) == 1);
+  written = (fclose(file) == 0) && written;
+  if (!written || rename(temp_path.c_str(), path.c_str()) < 0) {
+    unlink(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+gebaar::config::CacheReader::CacheReader(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+  if (fd < 0) {
+    return;
+  }
+  struct stat st {};
+  if (fstat(fd, &st) == 0 &&
+      static_cast<size_t>(st.st_size) >= sizeof(cache_header)) {
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED) {
+      data = static_cast<const char*>(map);
+      size = st.st_size;
+      offset = sizeof(cache_header);
+      ok = true;
+    }
+  }
+  close(fd);
+}
+
+gebaar::config::CacheReader::~CacheReader() {
+  if (data != nullptr) {
+    munmap(const_cast<char*>(data), size);
+  }
+}
+
+/**
+ * Check that the snapshot was written by a compatible version of gebaard
+ */
+bool gebaar::config::CacheReader::compatible() const {
+  if (data == nullptr) {
+    return false;
+  }
+  cache_header header{};
+  memcpy(&header, data, sizeof(header));
+  return header.magic == CONFIG_CACHE_MAGIC &&
+         header.version == CONFIG_CACHE_VERSION;
+}
+
+/**
+ * Check that the snapshot is compatible and was compiled from the file
+ * described by expected
+ */
+bool gebaar::config::CacheReader::matches(const cache_header& expected) const {
+  if (!compatible()) {
+    return false;
+  }
+  cache_header header{};
+  memcpy(&header, data, sizeof(header));
+  return header.device == expected.device &&
+         header.inode == expected.inode &&
+         header.mtime_sec == expected.mtime_sec &&
+         header.mtime_nsec == expected.mtime_nsec &&
+         header.size == expected.size;
+}
+
+bool gebaar::config::CacheReader::take(void* out, size_t length) {
+  if (!ok || size - offset < length) {
+    ok = false;
+    return false;
+  }
+  memcpy(out, data + offset, length);
+  offset += length;
+  return true;
+}
+
+bool gebaar::config::CacheReader::get(uint64_t* value) {
+  return take(value, sizeof(*value));
+}
+
+bool gebaar::config::CacheReader::get(double* value) {
+  return take(value, sizeof(*value));
+}
+
+bool gebaar::config::CacheReader::get(bool* value) {
+  char byte = 0;
+  if (!take(&byte, 1)) {
+    return false;
+  }
+  *value = byte != 0;
+  return true;
+}
+
+bool gebaar::config::CacheReader::get(std::string* value) {
+  uint64_t length = 0;
+  if (!get(&length) || size - offset < length) {
+    ok = false;
+    return false;
+  }
+  value->assign(data + offset, length);
+  offset += length;
+  return true;
+}
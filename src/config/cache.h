@@ -0,0 +1,102 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SRC_CONFIG_CACHE_H_
+#define SRC_CONFIG_CACHE_H_
+
+#include <sys/types.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#define CONFIG_CACHE_MAGIC 0x43424547  // "GEBC"
+#define CONFIG_CACHE_VERSION 15
+
+namespace gebaar::config {
+/*
+ * Identifies the TOML file a snapshot was compiled from by its status, so a
+ * snapshot is checked without reading the file. It is only used when every
+ * field matches the file currently on disk. Editors that save by renaming
+ * change the inode, the others the nanosecond mtime.
+ */
+struct cache_header {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t device;
+  uint64_t inode;
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+  uint64_t size;
+};
+
+bool describe_file(const std::string& path, cache_header* header);
+
+bool read_owned_file(const std::string& path, uid_t owner,
+                     cache_header* header, std::string* contents);
+
+/*
+ * Serializes the compiled configuration into a flat buffer and writes it
+ * atomically next to the TOML file.
+ */
+class CacheWriter {
+ public:
+  void put(uint64_t value);
+  void put(double value);
+  void put(bool value);
+  void put(const std::string& value);
+
+  bool write(const std::string& path, const cache_header& header);
+
+ private:
+  std::string buffer;
+};
+
+/*
+ * Read-only view of a snapshot mapped into memory. Every getter fails once
+ * the end of the mapping is reached, so a truncated file is rejected instead
+ * of being partially applied.
+ */
+class CacheReader {
+ public:
+  explicit CacheReader(const std::string& path);
+  ~CacheReader();
+
+  CacheReader(const CacheReader&) = delete;
+  CacheReader& operator=(const CacheReader&) = delete;
+
+  bool compatible() const;
+  bool matches(const cache_header& expected) const;
+
+  bool get(uint64_t* value);
+  bool get(double* value);
+  bool get(bool* value);
+  bool get(std::string* value);
+
+  bool done() const { return ok && offset == size; }
+
+ private:
+  bool take(void* out, size_t length);
+
+  const char* data = nullptr;
+  size_t size = 0;
+  size_t offset = 0;
+  bool ok = false;
+};
+}  // namespace gebaar::config
+
+#endif  // SRC_CONFIG_CACHE_H_
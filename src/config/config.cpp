@@ -17,7 +17,12 @@
 */
 
 #include "config.h"
+#include <fnmatch.h>
+#include <algorithm>
 #include <zconf.h>
+#include <chrono>
+#include <cmath>
+#include <sstream>
 #include "utils/string-from-char.h"
 #define FN "config"
 
@@ -29,104 +34,653 @@ bool gebaar::config::Config::config_file_exists() {
   return std::filesystem::exists(true_path);
 }
 
+/**
+ * Read the gesture settings of the global configuration or of a [[device]]
+ * section. Settings the table doesn't contain keep their current value.
+ *
+ * @param table root table or [[device]] section
+ * @param settings settings to update
+ */
+static void read_gesture_settings(
+    const cpptoml::table& table,
+    struct gebaar::config::Config::settings* settings) {
+  settings->gesture_swipe_threshold =
+      table.get_qualified_as<double>("settings.gesture_swipe.threshold")
+          .value_or(settings->gesture_swipe_threshold);
+  settings->gesture_swipe_unit =
+      table.get_qualified_as<std::string>("settings.gesture_swipe.unit")
+          .value_or(settings->gesture_swipe_unit);
+  settings->gesture_swipe_one_shot =
+      table.get_qualified_as<bool>("settings.gesture_swipe.one_shot")
+          .value_or(settings->gesture_swipe_one_shot);
+  settings->gesture_swipe_trigger_on_release =
+      table.get_qualified_as<bool>("settings.gesture_swipe.trigger_on_release")
+          .value_or(settings->gesture_swipe_trigger_on_release);
+  settings->touch_longswipe_screen_percentage =
+      table
+          .get_qualified_as<double>(
+              "settings.touch_swipe.longswipe_screen_percentage")
+          .value_or(settings->touch_longswipe_screen_percentage);
+
+  settings->swipe_sectors =
+      table.get_qualified_as<int>("settings.swipe.sectors")
+          .value_or(settings->swipe_sectors);
+  if (settings->swipe_sectors != 4 && settings->swipe_sectors != 8 &&
+      settings->swipe_sectors != 16) {
+    spdlog::get("main")->error(
+        "[{}] at {} - settings.swipe.sectors must be 4, 8 or 16, using 8", FN,
+        __LINE__);
+    settings->swipe_sectors = 8;
+  }
+  if (settings->swipe_sector_widths.size() !=
+      static_cast<size_t>(settings->swipe_sectors)) {
+    settings->swipe_sector_widths.clear();  // inherited for other sectors
+  }
+  settings->swipe_axis_width =
+      table.get_qualified_as<double>("settings.swipe.axis_width")
+          .value_or(settings->swipe_axis_width);
+  auto widths =
+      table.get_qualified_array_of<double>("settings.swipe.sector_widths");
+  if (widths) {
+    double sum = 0;
+    bool positive = true;
+    for (double width : *widths) {
+      sum += width;
+      positive = positive && width > 0;
+    }
+    if (widths->size() != static_cast<size_t>(settings->swipe_sectors) ||
+        !positive || std::fabs(sum - 360) > SECTOR_WIDTHS_TOLERANCE) {
+      spdlog::get("main")->error(
+          "[{}] at {} - settings.swipe.sector_widths must be {} angles above "
+          "0 adding up to 360, ignoring it",
+          FN, __LINE__, settings->swipe_sectors);
+    } else {
+      settings->swipe_sector_widths = *widths;
+    }
+  } else if (table.contains_qualified("settings.swipe.sector_widths")) {
+    spdlog::get("main")->error(
+        "[{}] at {} - settings.swipe.sector_widths must be an array of "
+        "numbers, ignoring it",
+        FN, __LINE__);
+  }
+  settings->swipe_momentum =
+      table.get_qualified_as<bool>("settings.swipe.momentum")
+          .value_or(settings->swipe_momentum);
+  settings->swipe_momentum_decay_ms =
+      table.get_qualified_as<double>("settings.swipe.momentum_decay_ms")
+          .value_or(settings->swipe_momentum_decay_ms);
+  settings->swipe_momentum_min_rate =
+      table.get_qualified_as<double>("settings.swipe.momentum_min_rate")
+          .value_or(settings->swipe_momentum_min_rate);
+  settings->swipe_drag_fingers =
+      table.get_qualified_as<int>("settings.swipe.drag_fingers")
+          .value_or(settings->swipe_drag_fingers);
+  settings->swipe_drag_speed =
+      table.get_qualified_as<double>("settings.swipe.drag_speed")
+          .value_or(settings->swipe_drag_speed);
+
+  settings->hold_delay_ms =
+      table.get_qualified_as<double>("settings.hold.delay_ms")
+          .value_or(settings->hold_delay_ms);
+  settings->hold_repeat_delay_ms =
+      table.get_qualified_as<double>("settings.hold.repeat_delay_ms")
+          .value_or(settings->hold_repeat_delay_ms);
+  settings->hold_repeat_rate =
+      table.get_qualified_as<double>("settings.hold.repeat_rate")
+          .value_or(settings->hold_repeat_rate);
+
+  settings->pinch_threshold =
+      table.get_qualified_as<double>("settings.pinch.threshold")
+          .value_or(settings->pinch_threshold);
+
+  settings->rotate_threshold =
+      table.get_qualified_as<double>("settings.rotate.threshold")
+          .value_or(settings->rotate_threshold);
+
+  settings->pinch_intent_updates =
+      table.get_qualified_as<int>("settings.pinch.intent_updates")
+          .value_or(settings->pinch_intent_updates);
+  settings->pinch_intent_hysteresis =
+      table.get_qualified_as<double>("settings.pinch.intent_hysteresis")
+          .value_or(settings->pinch_intent_hysteresis);
+}
+
+/**
+ * Read the bindings of the global configuration or of a [[device]] section.
+ * A kind of gesture the table has no commands for keeps its current bindings.
+ *
+ * @param table root table or [[device]] section
+ * @param device bindings to update
+ */
+static void read_commands(const cpptoml::table& table,
+                          gebaar::config::Config::device_config* device) {
+  spdlog::get("main")->debug("[{}] at {} - Generating SWIPE_COMMANDS", FN,
+                             __LINE__);
+  auto swipe_command_table = table.get_table_array_qualified("swipe.commands");
+  if (swipe_command_table == nullptr) {
+    spdlog::get("main")->debug("[{}] at {} - swipe_command_table empty", FN, __LINE__);
+  } else {
+    device->swipe_commands.clear();
+    for (const auto& entry : *swipe_command_table) {
+      auto fingers = entry->get_as<size_t>("fingers");
+      fingers = fingers.value_or(3);
+      auto type = entry->get_as<std::string>("type");
+      type = type.value_or("GESTURE");
+      auto region = entry->get_as<std::string>("region");
+      if (region) {
+        type = "TOUCH:" + *region;
+      }
+      for (std::pair<size_t, std::string> element : SWIPE_COMMANDS) {
+        device->swipe_commands[*fingers][*type][element.second] =
+            gebaar::config::CommandTemplate(
+                entry->get_qualified_as<std::string>(element.second)
+                    .value_or(""));
+      }
+    }
+  }
+
+  spdlog::get("main")->debug("[{}] at {} - Generating PINCH_COMMANDS", FN,
+                             __LINE__);
+  auto pinch_command_table = table.get_table_array_qualified("pinch.commands");
+  if (pinch_command_table == nullptr) {
+    spdlog::get("main")->debug("[{}] at {} - pinch_command_table empty", FN, __LINE__);
+  } else {
+    device->pinch_commands.clear();
+    for (const auto& entry : *pinch_command_table) {
+      auto fingers = entry->get_as<size_t>("fingers");
+      fingers = fingers.value_or(2);
+      auto type = entry->get_as<std::string>("type");
+      type = type.value_or("ONESHOT");
+      for (std::pair<size_t, std::string> element : PINCH_COMMANDS) {
+        device->pinch_commands[*fingers][*type][element.second] =
+            gebaar::config::CommandTemplate(
+                entry->get_qualified_as<std::string>(element.second)
+                    .value_or(""));
+      }
+    }
+  }
+
+  spdlog::get("main")->debug("[{}] at {} - Generating HOLD_COMMANDS", FN,
+                             __LINE__);
+  auto hold_command_table = table.get_table_array_qualified("hold.commands");
+  if (hold_command_table == nullptr) {
+    spdlog::get("main")->debug("[{}] at {} - hold_command_table empty", FN, __LINE__);
+  } else {
+    device->hold_commands.clear();
+    for (const auto& entry : *hold_command_table) {
+      auto fingers = entry->get_as<size_t>("fingers");
+      fingers = fingers.value_or(3);
+      auto type = entry->get_as<std::string>("type");
+      type = type.value_or("GESTURE");
+      for (std::pair<size_t, std::string> element : HOLD_COMMANDS) {
+        device->hold_commands[*fingers][*type][element.second] =
+            gebaar::config::CommandTemplate(
+                entry->get_qualified_as<std::string>(element.second)
+                    .value_or(""));
+      }
+    }
+  }
+
+  spdlog::get("main")->debug("[{}] at {} - Generating SWITCH_COMMANDS", FN,
+                             __LINE__);
+  auto switch_command_table =
+      table.get_table_array_qualified("switch.commands");
+  if (switch_command_table == nullptr) {
+    spdlog::get("main")->debug("[{}] at {} - switch_command_table empty", FN, __LINE__);
+  } else {
+    device->switch_commands.clear();
+    for (const auto& entry : *switch_command_table) {
+      for (std::pair<size_t, std::string> element : SWITCH_COMMANDS) {
+        device->switch_commands[element.second] =
+            gebaar::config::CommandTemplate(
+                entry->get_qualified_as<std::string>(element.second)
+                    .value_or(""));
+      }
+    }
+  }
+}
+
+/**
+ * Read the touchscreen regions of the global configuration or of a [[device]]
+ * section, which replace the inherited ones if there are any
+ *
+ * @param table root table or [[device]] section
+ * @param device regions to update
+ */
+static void read_touch_regions(const cpptoml::table& table,
+                               gebaar::config::Config::device_config* device) {
+  auto region_table = table.get_table_array_qualified("touch_swipe.regions");
+  if (region_table == nullptr) {
+    return;
+  }
+  device->regions.clear();
+  for (const auto& entry : *region_table) {
+    gebaar::config::Config::touch_region region;
+    region.name = entry->get_as<std::string>("name").value_or("");
+    region.x = std::clamp(entry->get_as<double>("x").value_or(0), 0.0, 100.0);
+    region.y = std::clamp(entry->get_as<double>("y").value_or(0), 0.0, 100.0);
+    region.width = std::clamp(entry->get_as<double>("width").value_or(100),
+                              0.0, 100.0 - region.x);
+    region.height = std::clamp(entry->get_as<double>("height").value_or(100),
+                               0.0, 100.0 - region.y);
+    if (region.name.empty() || region.width <= 0 || region.height <= 0) {
+      spdlog::get("main")->error(
+          "[{}] at {} - Ignoring touch_swipe.regions entry '{}' without a "
+          "name or an area",
+          FN, __LINE__, region.name);
+      continue;
+    }
+    region.binding = "TOUCH:" + region.name;
+    device->regions.push_back(std::move(region));
+  }
+}
+
+/**
+ * Read a [[device]] section on top of the global configuration
+ *
+ * @param table the section
+ * @param device starts out as the global configuration
+ * @return bool false if the section is invalid and must be ignored
+ */
+static bool read_device_config(const cpptoml::table& table,
+                               gebaar::config::Config::device_config* device) {
+  device->name = table.get_as<std::string>("name").value_or("");
+  device->vendor = table.get_as<int64_t>("vendor").value_or(-1);
+  device->product = table.get_as<int64_t>("product").value_or(-1);
+  std::string capability = table.get_as<std::string>("capability").value_or("");
+  if (capability == "touchpad") {
+    device->classes = DEVICE_TOUCHPAD;
+  } else if (capability == "touchscreen") {
+    device->classes = DEVICE_TOUCHSCREEN;
+  } else if (capability == "switch") {
+    device->classes = DEVICE_SWITCH;
+  } else if (!capability.empty()) {
+    spdlog::get("main")->error(
+        "[{}] at {} - Ignoring [[device]] with unknown capability '{}'", FN,
+        __LINE__, capability);
+    return false;
+  }
+  read_gesture_settings(table, &device->settings);
+  read_commands(table, device);
+  read_touch_regions(table, device);
+  return true;
+}
+
 /**
  * Load Configuration from TOML file
  */
 void gebaar::config::Config::load_config() {
   if (find_config_file()) {
     if (config_file_exists()) {
+      auto start = std::chrono::steady_clock::now();
+      cache_header header{};
+      std::string contents;
+      bool described =
+          owner == NO_OWNER
+              ? describe_file(config_file_path, &header)
+              : read_owned_file(config_file_path, owner, &header, nullptr);
+      bool cached = described && !cache_file_path.empty();
+      if (cached && load_cache(header)) {
+        loaded = true;
+        spdlog::get("main")->debug(
+            "[{}] at {} - Config loaded from cache in {} us", FN, __LINE__,
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count());
+        return;
+      }
+      // Only read on a miss, the header then describes what is parsed
+      if (owner != NO_OWNER &&
+          !read_owned_file(config_file_path, owner, &header, &contents)) {
+        spdlog::get("main")->error(
+            "[{}] at {} - {} is not a regular file owned by uid {}", FN,
+            __LINE__, config_file_path, owner);
+        return;
+      }
       try {
-        config = cpptoml::parse_file(std::filesystem::path(config_file_path));
+        if (owner == NO_OWNER) {
+          config =
+              cpptoml::parse_file(std::filesystem::path(config_file_path));
+        } else {
+          // Parse what was checked, the path may point elsewhere by now
+          std::istringstream stream(contents);
+          config = cpptoml::parser(stream).parse();
+        }
         spdlog::get("main")->debug("[{}] at {} - Config parsed", FN, __LINE__);
       } catch (const cpptoml::parse_exception& e) {
-        std::cerr << e.what() << std::endl;
+        // The snapshot holds the bindings of an older file, don't run them
+        spdlog::get("main")->error("[{}] at {} - {}: {}", FN, __LINE__,
+                                   config_file_path, e.what());
+        if (owner != NO_OWNER) {
+          // One user's typo must not take the other seats down
+          return;
+        }
+        spdlog::shutdown();
         exit(EXIT_FAILURE);
       }
-      spdlog::get("main")->debug("[{}] at {} - Generating SWIPE_COMMANDS", FN,
-                                 __LINE__);
-      auto swipe_command_table =
-          config->get_table_array_qualified("swipe.commands");
-      if (swipe_command_table == nullptr) {
-        spdlog::get("main")->debug("[{}] at {} - swipe_command_table empty", FN, __LINE__);
-      } else {
-        for (const auto& table : *swipe_command_table) {
-          auto fingers = table->get_as<size_t>("fingers");
-          fingers = fingers.value_or(3);
-          auto type = table->get_as<std::string>("type");
-          type = type.value_or("GESTURE");
-          for (std::pair<size_t, std::string> element : SWIPE_COMMANDS) {
-            swipe_commands[*fingers][*type][element.second] =
-                table->get_qualified_as<std::string>(element.second).value_or("");
+      read_gesture_settings(*config, &settings);
+      read_commands(*config, &defaults);
+      read_touch_regions(*config, &defaults);
+
+      settings.interact_type =
+          *config->get_qualified_as<std::string>("settings.interact.type");
+
+      settings.command_timeout =
+          config->get_qualified_as<double>("settings.commands.timeout")
+              .value_or(10);
+      settings.command_kill_grace =
+          config->get_qualified_as<double>("settings.commands.kill_grace")
+              .value_or(2);
+
+      settings.watchdog_budget_ms =
+          config->get_qualified_as<double>("settings.watchdog.budget_ms")
+              .value_or(20);
+
+      settings.adaptive_enabled =
+          config->get_qualified_as<bool>("settings.adaptive.enabled")
+              .value_or(false);
+      settings.adaptive_min_scale =
+          config->get_qualified_as<double>("settings.adaptive.min_scale")
+              .value_or(0.7);
+      settings.adaptive_max_scale =
+          config->get_qualified_as<double>("settings.adaptive.max_scale")
+              .value_or(1.3);
+      settings.adaptive_rate =
+          config->get_qualified_as<double>("settings.adaptive.rate")
+              .value_or(0.05);
+
+      settings.low_latency =
+          config->get_qualified_as<bool>("settings.low_latency.enabled")
+              .value_or(false);
+      settings.low_latency_cpu =
+          config->get_qualified_as<int>("settings.low_latency.cpu")
+              .value_or(-1);
+
+      defaults.settings = settings;
+      auto device_tables = config->get_table_array("device");
+      if (device_tables != nullptr) {
+        for (const auto& table : *device_tables) {
+          device_config device = defaults;
+          if (read_device_config(*table, &device)) {
+            device_configs.push_back(std::move(device));
           }
         }
       }
 
-      spdlog::get("main")->debug("[{}] at {} - Generating PINCH_COMMANDS", FN,
-                                 __LINE__);
-      auto pinch_command_table =
-          config->get_table_array_qualified("pinch.commands");
-      if (pinch_command_table == nullptr) {
-        spdlog::get("main")->debug("[{}] at {} - pinch_command_table empty", FN, __LINE__);
-      } else {
-        for (const auto& table : *pinch_command_table) {
-          auto fingers = table->get_as<size_t>("fingers");
-          fingers = fingers.value_or(2);
-          auto type = table->get_as<std::string>("type");
-          type = type.value_or("ONESHOT");
-          for (std::pair<size_t, std::string> element : PINCH_COMMANDS) {
-            pinch_commands[*fingers][*type][element.second] =
-                table->get_qualified_as<std::string>(element.second).value_or("");
-          }
-        }
+      loaded = true;
+      if (cached) {
+        write_cache(header);
       }
+      spdlog::get("main")->debug(
+          "[{}] at {} - Config loaded in {} us", FN, __LINE__,
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              std::chrono::steady_clock::now() - start)
+              .count());
+    }
+  }
+}
 
-      spdlog::get("main")->debug("[{}] at {} - Generating SWITCH_COMMANDS", FN,
-                                 __LINE__);
-      auto switch_command_table =
-          config->get_table_array_qualified("switch.commands");
-      if (switch_command_table == nullptr) {
-        spdlog::get("main")->debug("[{}] at {} - switch_command_table empty", FN, __LINE__);
-      } else {
-        for (const auto& table : *switch_command_table) {
-          for (std::pair<size_t, std::string> element : SWITCH_COMMANDS) {
-            switch_commands[element.second] =
-                table->get_qualified_as<std::string>(element.second).value_or("");
-          }
-        }
+static void put_commands(gebaar::config::CacheWriter& writer,
+                         const gebaar::config::Config::command_map& commands) {
+  writer.put(static_cast<uint64_t>(commands.size()));
+  for (const auto& [fingers, types] : commands) {
+    writer.put(static_cast<uint64_t>(fingers));
+    writer.put(static_cast<uint64_t>(types.size()));
+    for (const auto& [type, entries] : types) {
+      writer.put(type);
+      writer.put(static_cast<uint64_t>(entries.size()));
+      for (const auto& [name, command] : entries) {
+        writer.put(name);
+        writer.put(command.text());
       }
+    }
+  }
+}
 
-      settings.gesture_swipe_threshold =
-          config->get_qualified_as<double>("settings.gesture_swipe.threshold")
-              .value_or(0.5);
-      settings.gesture_swipe_one_shot =
-          config->get_qualified_as<bool>("settings.gesture_swipe.one_shot")
-              .value_or(true);
-      settings.gesture_swipe_trigger_on_release =
-          config
-              ->get_qualified_as<bool>(
-                  "settings.gesture_swipe.trigger_on_release")
-              .value_or(true);
-      settings.touch_longswipe_screen_percentage =
-          config
-              ->get_qualified_as<double>(
-                  "settings.touch_swipe.longswipe_screen_percentage")
-              .value_or(LONGSWIPE_SCREEN_PERCENT_DEFAULT);
-
-      settings.pinch_threshold =
-          config->get_qualified_as<double>("settings.pinch.threshold")
-              .value_or(0.25);
-
-      settings.rotate_threshold =
-          config->get_qualified_as<double>("settings.rotate.threshold")
-              .value_or(20);
+static bool get_commands(gebaar::config::CacheReader& reader,
+                         gebaar::config::Config::command_map* commands) {
+  uint64_t finger_count = 0;
+  if (!reader.get(&finger_count)) {
+    return false;
+  }
+  for (uint64_t i = 0; i < finger_count; ++i) {
+    uint64_t fingers = 0;
+    uint64_t type_count = 0;
+    if (!reader.get(&fingers) || !reader.get(&type_count)) {
+      return false;
+    }
+    for (uint64_t j = 0; j < type_count; ++j) {
+      std::string type;
+      uint64_t entry_count = 0;
+      if (!reader.get(&type) || !reader.get(&entry_count)) {
+        return false;
+      }
+      for (uint64_t k = 0; k < entry_count; ++k) {
+        std::string name;
+        std::string command;
+        if (!reader.get(&name) || !reader.get(&command)) {
+          return false;
+        }
+        (*commands)[fingers][type][name] =
+            gebaar::config::CommandTemplate(command);
+      }
+    }
+  }
+  return true;
+}
 
-      settings.interact_type =
-          *config->get_qualified_as<std::string>("settings.interact.type");
+static void put_settings(
+    gebaar::config::CacheWriter& writer,
+    const struct gebaar::config::Config::settings& settings) {
+  writer.put(settings.pinch_one_shot);
+  writer.put(settings.pinch_threshold);
+  writer.put(settings.rotate_threshold);
+  writer.put(static_cast<uint64_t>(settings.pinch_intent_updates));
+  writer.put(settings.pinch_intent_hysteresis);
+  writer.put(settings.gesture_swipe_one_shot);
+  writer.put(settings.gesture_swipe_threshold);
+  writer.put(settings.gesture_swipe_unit);
+  writer.put(settings.gesture_swipe_trigger_on_release);
+  writer.put(settings.touch_longswipe_screen_percentage);
+  writer.put(static_cast<uint64_t>(settings.swipe_sectors));
+  writer.put(settings.swipe_axis_width);
+  writer.put(static_cast<uint64_t>(settings.swipe_sector_widths.size()));
+  for (double width : settings.swipe_sector_widths) {
+    writer.put(width);
+  }
+  writer.put(settings.swipe_momentum);
+  writer.put(settings.swipe_momentum_decay_ms);
+  writer.put(settings.swipe_momentum_min_rate);
+  writer.put(static_cast<uint64_t>(settings.swipe_drag_fingers));
+  writer.put(settings.swipe_drag_speed);
+  writer.put(settings.hold_delay_ms);
+  writer.put(settings.hold_repeat_delay_ms);
+  writer.put(settings.hold_repeat_rate);
+  writer.put(settings.interact_type);
+  writer.put(settings.command_timeout);
+  writer.put(settings.command_kill_grace);
+  writer.put(settings.watchdog_budget_ms);
+  writer.put(settings.adaptive_enabled);
+  writer.put(settings.adaptive_min_scale);
+  writer.put(settings.adaptive_max_scale);
+  writer.put(settings.adaptive_rate);
+  writer.put(settings.low_latency);
+  writer.put(static_cast<uint64_t>(settings.low_latency_cpu));
+}
 
-      loaded = true;
-      spdlog::get("main")->debug("[{}] at {} - Config loaded", FN, __LINE__);
+static bool get_sector_widths(gebaar::config::CacheReader& reader,
+                              uint64_t sectors, std::vector<double>* widths) {
+  uint64_t count = 0;
+  if (!reader.get(&count) || (count != 0 && count != sectors)) {
+    return false;
+  }
+  widths->resize(count);
+  for (double& width : *widths) {
+    if (!reader.get(&width)) {
+      return false;
     }
   }
+  return true;
+}
+
+static bool get_settings(gebaar::config::CacheReader& reader,
+                         struct gebaar::config::Config::settings* settings) {
+  uint64_t low_latency_cpu = 0;
+  uint64_t swipe_sectors = 0;
+  uint64_t pinch_intent_updates = 0;
+  uint64_t swipe_drag_fingers = 0;
+  bool ok = reader.get(&settings->pinch_one_shot) &&
+            reader.get(&settings->pinch_threshold) &&
+            reader.get(&settings->rotate_threshold) &&
+            reader.get(&pinch_intent_updates) &&
+            reader.get(&settings->pinch_intent_hysteresis) &&
+            reader.get(&settings->gesture_swipe_one_shot) &&
+            reader.get(&settings->gesture_swipe_threshold) &&
+            reader.get(&settings->gesture_swipe_unit) &&
+            reader.get(&settings->gesture_swipe_trigger_on_release) &&
+            reader.get(&settings->touch_longswipe_screen_percentage) &&
+            reader.get(&swipe_sectors) &&
+            reader.get(&settings->swipe_axis_width) &&
+            get_sector_widths(reader, swipe_sectors,
+                              &settings->swipe_sector_widths) &&
+            reader.get(&settings->swipe_momentum) &&
+            reader.get(&settings->swipe_momentum_decay_ms) &&
+            reader.get(&settings->swipe_momentum_min_rate) &&
+            reader.get(&swipe_drag_fingers) &&
+            reader.get(&settings->swipe_drag_speed) &&
+            reader.get(&settings->hold_delay_ms) &&
+            reader.get(&settings->hold_repeat_delay_ms) &&
+            reader.get(&settings->hold_repeat_rate) &&
+            reader.get(&settings->interact_type) &&
+            reader.get(&settings->command_timeout) &&
+            reader.get(&settings->command_kill_grace) &&
+            reader.get(&settings->watchdog_budget_ms) &&
+            reader.get(&settings->adaptive_enabled) &&
+            reader.get(&settings->adaptive_min_scale) &&
+            reader.get(&settings->adaptive_max_scale) &&
+            reader.get(&settings->adaptive_rate) &&
+            reader.get(&settings->low_latency) && reader.get(&low_latency_cpu);
+  settings->low_latency_cpu = static_cast<int>(low_latency_cpu);
+  settings->swipe_sectors = static_cast<int>(swipe_sectors);
+  settings->pinch_intent_updates = static_cast<int>(pinch_intent_updates);
+  settings->swipe_drag_fingers = static_cast<int>(swipe_drag_fingers);
+  return ok;
+}
+
+static void put_device_config(
+    gebaar::config::CacheWriter& writer,
+    const gebaar::config::Config::device_config& device) {
+  writer.put(device.name);
+  writer.put(static_cast<uint64_t>(device.vendor));
+  writer.put(static_cast<uint64_t>(device.product));
+  writer.put(static_cast<uint64_t>(device.classes));
+  put_settings(writer, device.settings);
+  put_commands(writer, device.swipe_commands);
+  put_commands(writer, device.pinch_commands);
+  put_commands(writer, device.hold_commands);
+  writer.put(static_cast<uint64_t>(device.switch_commands.size()));
+  for (const auto& [key, command] : device.switch_commands) {
+    writer.put(key);
+    writer.put(command.text());
+  }
+  writer.put(static_cast<uint64_t>(device.regions.size()));
+  for (const auto& region : device.regions) {
+    writer.put(region.name);
+    writer.put(region.x);
+    writer.put(region.y);
+    writer.put(region.width);
+    writer.put(region.height);
+  }
+}
+
+static bool get_device_config(gebaar::config::CacheReader& reader,
+                              gebaar::config::Config::device_config* device) {
+  uint64_t vendor = 0;
+  uint64_t product = 0;
+  uint64_t classes = 0;
+  uint64_t switch_count = 0;
+  bool ok = reader.get(&device->name) && reader.get(&vendor) &&
+            reader.get(&product) && reader.get(&classes) &&
+            get_settings(reader, &device->settings) &&
+            get_commands(reader, &device->swipe_commands) &&
+            get_commands(reader, &device->pinch_commands) &&
+            get_commands(reader, &device->hold_commands) &&
+            reader.get(&switch_count);
+  for (uint64_t i = 0; ok && i < switch_count; ++i) {
+    std::string key;
+    std::string command;
+    ok = reader.get(&key) && reader.get(&command);
+    device->switch_commands[key] = gebaar::config::CommandTemplate(command);
+  }
+  uint64_t region_count = 0;
+  ok = ok && reader.get(&region_count);
+  for (uint64_t i = 0; ok && i < region_count; ++i) {
+    gebaar::config::Config::touch_region region;
+    ok = reader.get(&region.name) && reader.get(&region.x) &&
+         reader.get(&region.y) && reader.get(&region.width) &&
+         reader.get(&region.height);
+    region.binding = "TOUCH:" + region.name;
+    device->regions.push_back(std::move(region));
+  }
+  device->vendor = static_cast<int64_t>(vendor);
+  device->product = static_cast<int64_t>(product);
+  device->classes = static_cast<uint32_t>(classes);
+  return ok;
+}
+
+/**
+ * Load the compiled configuration from the snapshot next to the TOML file
+ *
+ * @param expected identity of the TOML file the snapshot must have been
+ * compiled from
+ * @return bool false if the snapshot is missing, stale or damaged
+ */
+bool gebaar::config::Config::load_cache(const cache_header& expected) {
+  CacheReader reader(cache_file_path);
+  if (!reader.matches(expected)) {
+    spdlog::get("main")->debug("[{}] at {} - Config cache stale or missing",
+                               FN, __LINE__);
+    return false;
+  }
+
+  device_config cached_defaults;
+  std::vector<device_config> cached_devices;
+  uint64_t device_count = 0;
+  bool ok = get_device_config(reader, &cached_defaults) &&
+            reader.get(&device_count);
+  for (uint64_t i = 0; ok && i < device_count; ++i) {
+    cached_devices.emplace_back();
+    ok = get_device_config(reader, &cached_devices.back());
+  }
+  if (!ok || !reader.done()) {
+    spdlog::get("main")->debug("[{}] at {} - Config cache damaged", FN,
+                               __LINE__);
+    return false;
+  }
+
+  settings = cached_defaults.settings;
+  defaults = std::move(cached_defaults);
+  device_configs.swap(cached_devices);
+  return true;
+}
+
+/**
+ * Write the compiled configuration to the snapshot next to the TOML file.
+ * Only called after the TOML parsed successfully.
+ *
+ * @param header identity of the TOML file the configuration came from
+ */
+void gebaar::config::Config::write_cache(const cache_header& header) {
+  CacheWriter writer;
+  put_device_config(writer, defaults);
+  writer.put(static_cast<uint64_t>(device_configs.size()));
+  for (const auto& device : device_configs) {
+    put_device_config(writer, device);
+  }
+  if (!writer.write(cache_file_path, header)) {
+    spdlog::get("main")->debug("[{}] at {} - Could not write config cache {}",
+                               FN, __LINE__, cache_file_path);
+  }
 }
 
 /**
@@ -134,8 +688,10 @@ void gebaar::config::Config::load_config() {
  * @return bool
  */
 bool gebaar::config::Config::find_config_file() {
-  std::string temp_path =
-      gebaar::util::stringFromCharArray(getenv("XDG_CONFIG_HOME"));
+  std::string temp_path = config_home;
+  if (temp_path.empty()) {
+    temp_path = gebaar::util::stringFromCharArray(getenv("XDG_CONFIG_HOME"));
+  }
   if (temp_path.empty()) {
     // first get the path to HOME
     temp_path = gebaar::util::stringFromCharArray(getenv("HOME"));
@@ -150,6 +706,11 @@ bool gebaar::config::Config::find_config_file() {
   if (!temp_path.empty()) {
     config_file_path = temp_path;
     config_file_path.append("/gebaar/gebaard.toml");
+    // Never a root owned cache in the home of a user whose seat is served
+    if (cache_file_path.empty() && owner == NO_OWNER) {
+      cache_file_path = temp_path;
+      cache_file_path.append("/gebaar/gebaard.cache");
+    }
     spdlog::get("main")->debug("[{}] at {} - config path generated: '{}'", FN,
                                __LINE__, config_file_path);
     return true;
@@ -166,34 +727,109 @@ gebaar::config::Config::Config() {
 }
 
 /**
- * Given a number of fingers and a swipe type return configured command
+ * Configuration of another user, read by gebaard serving several seats
+ *
+ * @param config_home the user's configuration directory, e.g. ~/.config
+ * @param cache_path where to keep the compiled snapshot, so no root owned
+ * file ends up in the user's home. Empty to keep none.
+ * @param owner the user, who must own the TOML file
+ */
+gebaar::config::Config::Config(const std::string& config_home,
+                               const std::string& cache_path, uid_t owner)
+    : config_home(config_home), owner(owner), cache_file_path(cache_path) {
+  load_config();
+}
+
+/**
+ * Look up a command without inserting missing entries, so lookups made while
+ * processing gestures never allocate
  */
+static const gebaar::config::CommandTemplate no_command;
+
+static const gebaar::config::CommandTemplate& find_command(
+    const gebaar::config::Config::command_map& commands, size_t fingers,
+    const std::string& type, const std::string& name) {
+  auto by_fingers = commands.find(fingers);
+  if (fingers == 0 || by_fingers == commands.end()) {
+    return no_command;
+  }
+  auto by_type = by_fingers->second.find(type);
+  if (by_type == by_fingers->second.end()) {
+    return no_command;
+  }
+  auto command = by_type->second.find(name);
+  return command == by_type->second.end() ? no_command : command->second;
+}
 
-std::string gebaar::config::Config::get_swipe_type_name(size_t key) {
+const std::string& gebaar::config::Config::get_swipe_type_name(
+    size_t key) const {
   return SWIPE_COMMANDS.at(key);
 }
 
-std::string gebaar::config::Config::get_swipe_command(size_t fingers,
-                                                std::string type,
-                                                size_t swipe_type) {
-    if (fingers > 0 && swipe_type >= MIN_DIRECTION &&
-      swipe_type <= MAX_DIRECTION) {
-    if (swipe_commands.count(fingers)) {
-      return swipe_commands[fingers][type][SWIPE_COMMANDS.at(swipe_type)];
+/**
+ * Find the settings and bindings for a device, called once when it is added
+ *
+ * @param name device name, matched against the glob of each section
+ * @param vendor USB vendor id
+ * @param product USB product id
+ * @param classes DEVICE_* bits the device has
+ * @return the first matching [[device]] section, or the global configuration
+ */
+const gebaar::config::Config::device_config&
+gebaar::config::Config::match_device(const std::string& name, uint32_t vendor,
+                                     uint32_t product, uint32_t classes) const {
+  for (const auto& device : device_configs) {
+    if ((device.name.empty() ||
+         fnmatch(device.name.c_str(), name.c_str(), 0) == 0) &&
+        (device.vendor < 0 || device.vendor == vendor) &&
+        (device.product < 0 || device.product == product) &&
+        (device.classes == 0 || (device.classes & classes) != 0)) {
+      return device;
     }
   }
-  return "";
+  return defaults;
 }
 
-std::string gebaar::config::Config::get_pinch_command(size_t fingers,
-                                                std::string type,
-                                                size_t swipe_type) {
-  if (fingers > 0 && pinch_commands.count(fingers)) {
-    return pinch_commands[fingers][type][PINCH_COMMANDS.at(swipe_type)];
+/**
+ * Given a number of fingers and a swipe type return configured command
+ */
+const gebaar::config::CommandTemplate& gebaar::config::Config::device_config::get_swipe_command(
+    size_t fingers, const std::string& type, size_t swipe_type) const {
+  if (swipe_type >= MIN_DIRECTION && swipe_type <= MAX_DIRECTION) {
+    return find_command(swipe_commands, fingers, type,
+                        SWIPE_COMMANDS.at(swipe_type));
   }
-  return "";
+  return no_command;
+}
+
+const gebaar::config::CommandTemplate& gebaar::config::Config::device_config::get_pinch_command(
+    size_t fingers, const std::string& type, size_t swipe_type) const {
+  return find_command(pinch_commands, fingers, type,
+                      PINCH_COMMANDS.at(swipe_type));
+}
+
+const gebaar::config::CommandTemplate& gebaar::config::Config::device_config::get_hold_command(
+    size_t fingers, const std::string& type) const {
+  return find_command(hold_commands, fingers, type, HOLD_COMMANDS.at(1));
+}
+
+const gebaar::config::CommandTemplate& gebaar::config::Config::device_config::get_switch_command(
+    size_t key) const {
+  auto command = switch_commands.find(SWITCH_COMMANDS.at(key));
+  return command == switch_commands.end() ? no_command : command->second;
+}
+
+const gebaar::config::CommandTemplate& gebaar::config::Config::get_swipe_command(
+    size_t fingers, const std::string& type, size_t swipe_type) const {
+  return defaults.get_swipe_command(fingers, type, swipe_type);
+}
+
+const gebaar::config::CommandTemplate& gebaar::config::Config::get_pinch_command(
+    size_t fingers, const std::string& type, size_t swipe_type) const {
+  return defaults.get_pinch_command(fingers, type, swipe_type);
 }
 
-std::string gebaar::config::Config::get_switch_command(size_t key) {
-  return switch_commands[SWITCH_COMMANDS.at(key)];
+const gebaar::config::CommandTemplate& gebaar::config::Config::get_switch_command(
+    size_t key) const {
+  return defaults.get_switch_command(key);
 }
@@ -22,6 +22,8 @@
 #include <cpptoml.h>
 #include <pwd.h>
 #include <spdlog/spdlog.h>
+#include "config/cache.h"
+#include "config/template.h"
 #include "utils/filesystem.h"
 #include <iostream>
 #include <map>
@@ -29,21 +31,37 @@
 #include <string>
 #include <utility>
 #include <iterator>
+#include <vector>
 
-#define MAX_DIRECTION 9
+#define MAX_DIRECTION 17
 #define MIN_DIRECTION 1
 #define LONGSWIPE_SCREEN_PERCENT_DEFAULT 70
+#define SECTOR_WIDTHS_TOLERANCE 0.01  // degrees off 360 the widths may add up to
+#define NO_OWNER static_cast<uid_t>(-1)  // whoever gebaard runs as
+
+// Device classes a [[device]] section can be restricted to
+#define DEVICE_TOUCHPAD 1
+#define DEVICE_TOUCHSCREEN 2
+#define DEVICE_SWITCH 4
 
 const std::map<size_t, std::string> SWIPE_COMMANDS = {
     {1, "left_up"},        {2, "up"},
     {3, "right_up"},       {4, "left"},
     {6, "right"},          {7, "left_down"},
-    {8, "down"},           {9, "right_down"}
+    {8, "down"},           {9, "right_down"},
+    // Only with 16 sectors, named after the sectors they lie between
+    {10, "up_left_up"},    {11, "up_right_up"},
+    {12, "left_left_up"},  {13, "right_right_up"},
+    {14, "left_left_down"}, {15, "right_right_down"},
+    {16, "down_left_down"}, {17, "down_right_down"}
 };
 const std::map<size_t, std::string> PINCH_COMMANDS = {
     {1, "in"},             {2, "out"},
     {3, "rotate_left"},    {4, "rotate_right"}
 };
+const std::map<size_t, std::string> HOLD_COMMANDS = {
+    {1, "hold"}
+};
 const std::map<size_t, std::string> SWITCH_COMMANDS = {
     {0, "laptop"},         {1, "tablet"}
 };
@@ -53,27 +71,107 @@ class Config {
    public:
     Config();
 
+    Config(const std::string& config_home, const std::string& cache_path,
+           uid_t owner);
+
     bool loaded = false;
 
     void load_config();
 
     struct settings {
-        bool pinch_one_shot;
-        double pinch_threshold;
-        double rotate_threshold;
+        // Gesture settings, a [[device]] section can override these
+        bool pinch_one_shot = false;
+        double pinch_threshold = 0.25;
+        double rotate_threshold = 20;
+        int pinch_intent_updates = 3;  // 0 evaluates pinch and rotate throughout
+        double pinch_intent_hysteresis = 2;
+
+        bool gesture_swipe_one_shot = true;
+        double gesture_swipe_threshold = 0.5;
+        std::string gesture_swipe_unit = "dpi";
+        bool gesture_swipe_trigger_on_release = true;
+
+        double touch_longswipe_screen_percentage = LONGSWIPE_SCREEN_PERCENT_DEFAULT;
+
+        int swipe_sectors = 8;
+        double swipe_axis_width = 0;  // degrees, 0 for sectors of equal width
+        // Degrees of each sector from right on, empty to use swipe_axis_width
+        std::vector<double> swipe_sector_widths;
+
+        bool swipe_momentum = false;  // continuous swipes only
+        double swipe_momentum_decay_ms = 325;
+        double swipe_momentum_min_rate = 2;  // steps per second
 
-        bool gesture_swipe_one_shot;
-        double gesture_swipe_threshold;
-        bool gesture_swipe_trigger_on_release;
+        int swipe_drag_fingers = 0;  // touchpad swipes that drag, 0 for none
+        double swipe_drag_speed = 1;
+
+        double hold_delay_ms = 300;
+        double hold_repeat_delay_ms = 500;
+        double hold_repeat_rate = 0;  // per second, 0 runs a hold once
 
-        double touch_longswipe_screen_percentage;
         std::string interact_type;
+
+        double command_timeout = 10;
+        double command_kill_grace = 2;
+
+        double watchdog_budget_ms = 20;
+
+        bool adaptive_enabled = false;
+        double adaptive_min_scale = 0.7;
+        double adaptive_max_scale = 1.3;
+        double adaptive_rate = 0.05;
+
+        bool low_latency = false;
+        int low_latency_cpu = -1;
     } settings;
 
-    std::string get_swipe_command(size_t fingers, std::string type, size_t swipe_type);
-    std::string get_pinch_command(size_t fingers, std::string type, size_t swipe_type);
-    std::string get_switch_command(size_t key);
-    std::string get_swipe_type_name(size_t key);
+    /*
+     * Part of a touchscreen, in percent of its size. Swipes starting in it
+     * run the bindings of the [[swipe.commands]] naming it first.
+     */
+    struct touch_region {
+        std::string name;
+        double x = 0;
+        double y = 0;
+        double width = 0;
+        double height = 0;
+        std::string binding;  // swipe command type, "TOUCH:<name>"
+    };
+
+    using command_map =
+        std::map<size_t, std::map<std::string, std::map<std::string, CommandTemplate>>>;
+
+    /*
+     * Settings and bindings of the devices a [[device]] section matches, or
+     * of every device none matches. Sections inherit whatever they don't set
+     * from the global configuration.
+     */
+    struct device_config {
+        std::string name;        // glob on the device name, empty matches any
+        int64_t vendor = -1;     // -1 matches any
+        int64_t product = -1;
+        uint32_t classes = 0;    // DEVICE_* bits, 0 matches any
+
+        struct settings settings;
+        command_map swipe_commands;
+        command_map pinch_commands;
+        command_map hold_commands;
+        std::map<std::string, CommandTemplate> switch_commands;
+        std::vector<touch_region> regions;  // the first one a swipe starts in wins
+
+        const CommandTemplate& get_swipe_command(size_t fingers, const std::string& type, size_t swipe_type) const;
+        const CommandTemplate& get_pinch_command(size_t fingers, const std::string& type, size_t swipe_type) const;
+        const CommandTemplate& get_hold_command(size_t fingers, const std::string& type) const;
+        const CommandTemplate& get_switch_command(size_t key) const;
+    };
+
+    const device_config& match_device(const std::string& name, uint32_t vendor,
+                                      uint32_t product, uint32_t classes) const;
+
+    const CommandTemplate& get_swipe_command(size_t fingers, const std::string& type, size_t swipe_type) const;
+    const CommandTemplate& get_pinch_command(size_t fingers, const std::string& type, size_t swipe_type) const;
+    const CommandTemplate& get_switch_command(size_t key) const;
+    const std::string& get_swipe_type_name(size_t key) const;
 
 
    private:
@@ -81,11 +179,19 @@ class Config {
 
     bool find_config_file();
 
+    bool load_cache(const cache_header& expected);
+
+    void write_cache(const cache_header& header);
+
+    std::string config_home;  // instead of $XDG_CONFIG_HOME when serving seats
+    uid_t owner = NO_OWNER;   // the file must belong to, when serving seats
     std::string config_file_path;
+    std::string cache_file_path;
     std::shared_ptr<cpptoml::table> config;
-    std::map<size_t, std::map<std::string, std::map<std::string, std::string>>> swipe_commands;
-    std::map<size_t, std::map<std::string, std::map<std::string, std::string>>> pinch_commands;
-    std::map<std::string, std::string> switch_commands;
+    device_config defaults;
+    // In file order, the first match wins. Never resized after loading,
+    // devices keep pointers into it.
+    std::vector<device_config> device_configs;
 };
 }  // namespace gebaar::config
 #endif  // SRC_CONFIG_CONFIG_H_
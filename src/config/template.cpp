@@ -0,0 +1,128 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config/template.h"
+#include <cinttypes>
+#include <cstdio>
+#include <utility>
+
+namespace {
+struct placeholder {
+  const char* name;
+  gebaar::config::CommandTemplate::field kind;
+};
+
+const placeholder PLACEHOLDERS[] = {
+    {"fingers", gebaar::config::CommandTemplate::FINGERS},
+    {"direction", gebaar::config::CommandTemplate::DIRECTION},
+    {"step", gebaar::config::CommandTemplate::STEP},
+    {"scale", gebaar::config::CommandTemplate::SCALE},
+    {"angle", gebaar::config::CommandTemplate::ANGLE},
+    {"dx", gebaar::config::CommandTemplate::DX},
+    {"dy", gebaar::config::CommandTemplate::DY},
+    {"duration_ms", gebaar::config::CommandTemplate::DURATION_MS},
+};
+}  // namespace
+
+/**
+ * Split command into literal text and placeholders
+ *
+ * @param command command as written in the configuration
+ */
+gebaar::config::CommandTemplate::CommandTemplate(std::string command)
+    : source(std::move(command)) {
+  size_t literal = 0;
+  size_t open = source.find('{');
+  while (open != std::string::npos) {
+    size_t close = source.find('}', open);
+    if (close == std::string::npos) {
+      break;
+    }
+    const placeholder* found = nullptr;
+    for (const auto& p : PLACEHOLDERS) {
+      if (source.compare(open + 1, close - open - 1, p.name) == 0) {
+        found = &p;
+      }
+    }
+    if (found == nullptr) {
+      open = source.find('{', open + 1);
+      continue;
+    }
+    if (open > literal) {
+      segments.push_back({LITERAL, static_cast<uint32_t>(literal),
+                          static_cast<uint32_t>(open - literal)});
+    }
+    segments.push_back({found->kind, 0, 0});
+    ++parameters;
+    literal = close + 1;
+    open = source.find('{', literal);
+  }
+  if (literal < source.size()) {
+    segments.push_back({LITERAL, static_cast<uint32_t>(literal),
+                        static_cast<uint32_t>(source.size() - literal)});
+  }
+}
+
+/**
+ * Fill in the placeholders. Doesn't allocate once out has grown to the
+ * longest command rendered.
+ *
+ * @param values what the gesture fills the placeholders with
+ * @param out receives the command line
+ */
+void gebaar::config::CommandTemplate::render(const gesture_fields& values,
+                                             std::string* out) const {
+  out->clear();
+  char number[32];
+  for (const auto& s : segments) {
+    int length = 0;
+    switch (s.kind) {
+      case LITERAL:
+        out->append(source, s.offset, s.length);
+        continue;
+      case FINGERS:
+        length = snprintf(number, sizeof(number), "%zu", values.fingers);
+        break;
+      case DIRECTION:
+        if (values.direction != nullptr) {
+          out->append(*values.direction);
+        }
+        continue;
+      case STEP:
+        length = snprintf(number, sizeof(number), "%d", values.step);
+        break;
+      case SCALE:
+        length = snprintf(number, sizeof(number), "%g", values.scale);
+        break;
+      case ANGLE:
+        length = snprintf(number, sizeof(number), "%g", values.angle);
+        break;
+      case DX:
+        length = snprintf(number, sizeof(number), "%g", values.dx);
+        break;
+      case DY:
+        length = snprintf(number, sizeof(number), "%g", values.dy);
+        break;
+      case DURATION_MS:
+        length = snprintf(number, sizeof(number), "%" PRIu64,
+                          values.duration_ms);
+        break;
+    }
+    out->append(number, length);
+  }
+}
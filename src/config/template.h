@@ -0,0 +1,87 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SRC_CONFIG_TEMPLATE_H_
+#define SRC_CONFIG_TEMPLATE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gebaar::config {
+/*
+ * What a gesture fills a command's placeholders with
+ */
+struct gesture_fields {
+  size_t fingers = 0;
+  const std::string* direction = nullptr;  // e.g. "left_up" or "in"
+  int step = 0;                            // commands run so far, this one included
+  double scale = 0;
+  double angle = 0;
+  double dx = 0;  // gesture delta units on touchpads, mm on touchscreens
+  double dy = 0;
+  uint64_t duration_ms = 0;  // since the gesture began
+};
+
+/*
+ * A configured command with {fingers}, {direction}, {step}, {scale},
+ * {angle}, {dx}, {dy} and {duration_ms} placeholders. It is split into
+ * literal text and fields once when the configuration is loaded, so running
+ * it only appends to a buffer. Braces that don't form one of these names are
+ * kept as they are, shell brace expansion keeps working.
+ */
+class CommandTemplate {
+ public:
+  enum field : uint8_t {
+    LITERAL,
+    FINGERS,
+    DIRECTION,
+    STEP,
+    SCALE,
+    ANGLE,
+    DX,
+    DY,
+    DURATION_MS,
+  };
+
+  CommandTemplate() = default;
+  explicit CommandTemplate(std::string command);
+
+  const std::string& text() const { return source; }
+
+  bool empty() const { return source.empty(); }
+
+  bool parameterized() const { return parameters > 0; }
+
+  void render(const gesture_fields& values, std::string* out) const;
+
+ private:
+  struct segment {
+    field kind;
+    uint32_t offset;  // of the literal text in source
+    uint32_t length;
+  };
+
+  std::string source;
+  std::vector<segment> segments;
+  size_t parameters = 0;
+};
+}  // namespace gebaar::config
+
+#endif  // SRC_CONFIG_TEMPLATE_H_
@@ -35,7 +35,6 @@ bool gebaar::daemonizer::Daemonizer::daemonize() {
     if (setsid() < 0) {
         // Boo.
     }
-    signal(SIGCHLD, SIG_IGN);
     signal(SIGTRAP, SIG_IGN);
     pid = fork();
     if (pid < 0) {
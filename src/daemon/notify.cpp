@@ -0,0 +1,145 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "daemon/notify.h"
+#include <unistd.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include "config/config.h"
+
+#define FN "notify"
+
+/**
+ * Read the socket and watchdog the service manager handed us. The
+ * variables are removed so commands run for gestures don't inherit them.
+ */
+gebaar::daemon::Notifier::Notifier() {
+  const char* path = getenv("NOTIFY_SOCKET");
+  const char* usec = getenv("WATCHDOG_USEC");
+  const char* pid = getenv("WATCHDOG_PID");
+  if (usec != nullptr &&
+      (pid == nullptr || atol(pid) == static_cast<long>(getpid()))) {
+    watchdog_usec = strtoull(usec, nullptr, 10);
+  }
+
+  size_t length = path != nullptr ? strlen(path) : 0;
+  if (length > 1 && length < sizeof(address.sun_path) &&
+      (path[0] == '/' || path[0] == '@')) {
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path, length);
+    address_length = offsetof(struct sockaddr_un, sun_path) + length;
+    if (path[0] == '@') {
+      address.sun_path[0] = '\0';  // abstract namespace, not terminated
+    } else {
+      ++address_length;
+    }
+    socket_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  } else if (path != nullptr) {
+    spdlog::get("main")->warn("[{}] Unsupported NOTIFY_SOCKET {}", FN, path);
+  }
+  if (socket_fd < 0) {
+    watchdog_usec = 0;
+  }
+  unsetenv("NOTIFY_SOCKET");
+  unsetenv("WATCHDOG_USEC");
+  unsetenv("WATCHDOG_PID");
+}
+
+gebaar::daemon::Notifier::~Notifier() {
+  if (attached_loop != nullptr) {
+    attached_loop->unwatch(timer.fd());
+  }
+  if (socket_fd >= 0) {
+    close(socket_fd);
+  }
+}
+
+/**
+ * Send newline separated assignments, e.g. "READY=1"
+ *
+ * @param state message as sd_notify takes it
+ * @return whether the service manager got it
+ */
+bool gebaar::daemon::Notifier::send(const std::string& state) {
+  if (socket_fd < 0) {
+    return false;
+  }
+  return sendto(socket_fd, state.data(), state.size(),
+                MSG_NOSIGNAL | MSG_DONTWAIT,
+                reinterpret_cast<const struct sockaddr*>(&address),
+                address_length) == static_cast<ssize_t>(state.size());
+}
+
+/**
+ * Report startup as finished, then keep the status current and feed the
+ * watchdog from the event loop
+ *
+ * @param loop event loop whose progress the pings vouch for
+ * @param status renders the STATUS= line, called on every tick
+ */
+void gebaar::daemon::Notifier::ready(gebaar::io::EventLoop& loop,
+                                     std::function<std::string()> status) {
+  if (socket_fd < 0) {
+    return;
+  }
+  this->status = std::move(status);
+  send("READY=1\nSTATUS=" + this->status());
+
+  // Twice per watchdog period, as systemd recommends
+  if (watchdog_usec > 0) {
+    interval_ms = std::max<uint64_t>(watchdog_usec / 2000, 1);
+    spdlog::get("main")->debug("[{}] Watchdog ping every {} ms", FN,
+                               interval_ms);
+  }
+  attached_loop = &loop;
+  loop.watch(timer.fd(), [this] { tick(); });
+  timer.arm(interval_ms, interval_ms);
+}
+
+void gebaar::daemon::Notifier::stopping() {
+  if (attached_loop != nullptr) {
+    timer.disarm();
+  }
+  send("STOPPING=1");
+}
+
+/**
+ * Only a loop that serviced the timer within its interval counts as making
+ * progress. When a tick was overrun, the loop was stuck for at least half a
+ * watchdog period: its ping is held back and the timer fires again right
+ * away, so the ping goes out as soon as the loop shows it runs again. A loop
+ * that stays stuck misses that tick too and gets restarted.
+ */
+void gebaar::daemon::Notifier::tick() {
+  uint64_t expired = timer.expirations();
+  if (expired == 0) {
+    return;
+  }
+  std::string state;
+  if (watchdog_usec > 0 && expired == 1) {
+    state = "WATCHDOG=1\n";
+  } else if (watchdog_usec > 0) {
+    spdlog::get("main")->warn("[{}] Event loop missed {} watchdog ticks",
+                              FN, expired - 1);
+    timer.arm(0, interval_ms);
+  }
+  state += "STATUS=" + status();
+  send(state);
+}
@@ -0,0 +1,66 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SRC_DAEMON_NOTIFY_H_
+#define SRC_DAEMON_NOTIFY_H_
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "io/loop.h"
+
+#define NOTIFY_STATUS_INTERVAL_MS 10000  // without a watchdog
+
+namespace gebaar::daemon {
+/*
+ * Speaks systemd's sd_notify protocol straight to $NOTIFY_SOCKET, without
+ * linking libsystemd, so units can use Type=notify and WatchdogSec=. Does
+ * nothing when the service manager did not ask for notifications.
+ */
+class Notifier {
+ public:
+  Notifier();
+  ~Notifier();
+
+  Notifier(const Notifier&) = delete;
+  Notifier& operator=(const Notifier&) = delete;
+
+  bool enabled() const { return socket_fd >= 0; }
+
+  bool send(const std::string& state);
+
+  void ready(gebaar::io::EventLoop& loop, std::function<std::string()> status);
+
+  void stopping();
+
+ private:
+  void tick();
+
+  int socket_fd = -1;
+  struct sockaddr_un address {};
+  socklen_t address_length = 0;
+  uint64_t watchdog_usec = 0;  // 0 when no watchdog pings are expected
+  uint64_t interval_ms = NOTIFY_STATUS_INTERVAL_MS;
+  gebaar::io::EventLoop* attached_loop = nullptr;
+  gebaar::io::Timer timer;
+  std::function<std::string()> status;
+};
+}  // namespace gebaar::daemon
+
+#endif  // SRC_DAEMON_NOTIFY_H_
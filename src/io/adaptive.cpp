@@ -0,0 +1,260 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "io/adaptive.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#define FN "adaptive"
+
+struct adaptive_header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t count;
+  uint32_t record_size;
+};
+
+/**
+ * Read the persisted history. Only does anything if adaptive thresholds are
+ * enabled in the configuration.
+ *
+ * @param state_path file the history is kept in
+ * @param config configuration holding the bounds
+ */
+void gebaar::io::AdaptiveThresholds::load(
+    const std::string& state_path, const gebaar::config::Config& config) {
+  enabled = config.settings.adaptive_enabled && !state_path.empty();
+  if (!enabled) {
+    return;
+  }
+  min_scale = config.settings.adaptive_min_scale;
+  max_scale = config.settings.adaptive_max_scale;
+  rate = config.settings.adaptive_rate;
+  path = state_path;
+  // Devices hold pointers into entries, it must never reallocate
+  entries.reserve(ADAPTIVE_MAX_DEVICES);
+  owners.reserve(ADAPTIVE_MAX_DEVICES);
+
+  FILE* file = fopen(path.c_str(), "rbe");
+  if (file == nullptr) {
+    return;
+  }
+  adaptive_header header{};
+  if (fread(&header, sizeof(header), 1, file) == 1 &&
+      header.magic == ADAPTIVE_MAGIC && header.version == ADAPTIVE_VERSION &&
+      header.record_size == sizeof(adaptive_device)) {
+    adaptive_device entry{};
+    for (uint32_t i = 0; i < header.count && i < ADAPTIVE_MAX_DEVICES &&
+                         fread(&entry, sizeof(entry), 1, file) == 1;
+         ++i) {
+      entry.name[TRACE_DEVICE_NAME - 1] = '\0';
+      entry.scale = std::clamp<float>(entry.scale, min_scale, max_scale);
+      entries.push_back(entry);
+      owners.push_back(nullptr);
+    }
+  }
+  fclose(file);
+  spdlog::get("main")->debug("[{}] at {} - Loaded history of {} devices", FN,
+                             __LINE__, entries.size());
+}
+
+/**
+ * Give a newly added device its history, reusing the least used entry once
+ * ADAPTIVE_MAX_DEVICES devices are known. Only entries of devices that are
+ * gone are reused, their device is detached first. With every entry in use
+ * the device goes without adaptive thresholds.
+ */
+void gebaar::io::AdaptiveThresholds::attach(device_state* device) {
+  device->adaptive = nullptr;
+  if (!enabled) {
+    return;
+  }
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (strncmp(entries[i].name, device->info.name, TRACE_DEVICE_NAME) == 0) {
+      if (owners[i] != nullptr && owners[i] != device) {
+        owners[i]->adaptive = nullptr;
+      }
+      owners[i] = device;
+      device->adaptive = &entries[i];
+      return;
+    }
+  }
+  size_t index;
+  if (entries.size() < ADAPTIVE_MAX_DEVICES) {
+    entries.emplace_back();
+    owners.push_back(nullptr);
+    index = entries.size() - 1;
+  } else {
+    auto uses = [](const adaptive_device& d) {
+      uint64_t total = 0;
+      for (const auto& fingers : d.bindings) {
+        for (const auto& b : fingers) {
+          total += b.count;
+        }
+      }
+      return total;
+    };
+    index = entries.size();
+    for (size_t i = 0; i < entries.size(); ++i) {
+      bool attached = owners[i] != nullptr && owners[i]->device != nullptr;
+      if (!attached &&
+          (index == entries.size() || uses(entries[i]) < uses(entries[index]))) {
+        index = i;
+      }
+    }
+    if (index == entries.size()) {
+      spdlog::get("main")->info(
+          "[{}] at {} - No history left for {}, thresholds stay as configured",
+          FN, __LINE__, device->info.name);
+      return;
+    }
+    if (owners[index] != nullptr) {
+      owners[index]->adaptive = nullptr;
+    }
+    if (retry.device == &entries[index]) {
+      retry = {};
+    }
+  }
+  adaptive_device* entry = &entries[index];
+  *entry = {};
+  strncpy(entry->name, device->info.name, TRACE_DEVICE_NAME - 1);
+  entry->scale = std::clamp(1.0, min_scale, max_scale);
+  owners[index] = device;
+  device->adaptive = entry;
+}
+
+gebaar::io::adaptive_binding* gebaar::io::AdaptiveThresholds::binding(
+    adaptive_device* device, size_t fingers, size_t direction) {
+  if (fingers < 1 || fingers > ADAPTIVE_FINGERS || direction < 1 ||
+      direction > ADAPTIVE_DIRECTIONS) {
+    return nullptr;
+  }
+  return &device->bindings[fingers - 1][direction - 1];
+}
+
+/**
+ * A swipe ended without triggering
+ *
+ * @param ratio distance covered relative to the threshold
+ * @param time event time in usec
+ */
+void gebaar::io::AdaptiveThresholds::near_miss(device_state* device,
+                                               size_t fingers,
+                                               size_t direction, double ratio,
+                                               uint64_t time) {
+  if (device->adaptive == nullptr || ratio < ADAPTIVE_NEAR_MISS) {
+    return;
+  }
+  auto b = binding(device->adaptive, fingers, direction);
+  if (b == nullptr) {
+    return;
+  }
+  ++b->near_misses;
+  retry = {device->adaptive, fingers, direction, time};
+}
+
+/**
+ * A swipe triggered. If it repeats a recent near miss the threshold was too
+ * high, otherwise it drifts back towards the configured value.
+ *
+ * @param ratio distance covered relative to the threshold
+ * @param duration gesture duration in usec
+ * @param time event time in usec
+ */
+void gebaar::io::AdaptiveThresholds::success(device_state* device,
+                                             size_t fingers, size_t direction,
+                                             double ratio, uint64_t duration,
+                                             uint64_t time) {
+  adaptive_device* d = device->adaptive;
+  if (d == nullptr) {
+    return;
+  }
+  auto b = binding(d, fingers, direction);
+  if (b == nullptr) {
+    return;
+  }
+  ++b->count;
+  float weight = b->count < 16 ? 1.0f / b->count : 1.0f / 16;
+  b->mean_length += weight * (ratio - b->mean_length);
+  b->mean_duration += weight * (duration / 1000.0f - b->mean_duration);
+
+  float old_scale = d->scale;
+  if (retry.device == d && retry.fingers == fingers &&
+      retry.direction == direction && time - retry.time < ADAPTIVE_RETRY_USEC) {
+    d->scale *= 1 - rate;
+  } else {
+    d->scale += rate / 10 * (1 - d->scale);
+  }
+  d->scale = std::clamp<float>(d->scale, min_scale, max_scale);
+  retry = {};
+
+  if (std::abs(d->scale - old_scale) > 0.01 ||
+      ++unsaved >= ADAPTIVE_SAVE_EVERY) {
+    spdlog::get("main")->debug("[{}] at {} - {} threshold scale {}", FN,
+                               __LINE__, d->name, d->scale);
+    unsaved = 0;
+    dirty = true;
+  }
+}
+
+void gebaar::io::AdaptiveThresholds::rejected(device_state* device) {
+  if (device->adaptive != nullptr) {
+    ++device->adaptive->rejections;
+  }
+}
+
+/**
+ * Whether the caller should arm a timer to save the history. True once per
+ * change, until save() ran.
+ */
+bool gebaar::io::AdaptiveThresholds::schedule_save() {
+  if (!dirty || scheduled) {
+    return false;
+  }
+  scheduled = true;
+  return true;
+}
+
+/**
+ * Write the history if it changed. Called from the event loop's timer, never
+ * while an event is being processed.
+ */
+void gebaar::io::AdaptiveThresholds::save() {
+  if (!dirty) {
+    return;
+  }
+  dirty = false;
+  scheduled = false;
+  std::string temp_path = path + ".tmp";
+  FILE* file = fopen(temp_path.c_str(), "wbe");
+  if (file == nullptr) {
+    return;
+  }
+  adaptive_header header = {ADAPTIVE_MAGIC, ADAPTIVE_VERSION,
+                            static_cast<uint32_t>(entries.size()),
+                            sizeof(adaptive_device)};
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(entries.data(), sizeof(adaptive_device), entries.size(),
+                   file) == entries.size();
+  if (fclose(file) != 0 || !ok ||
+      rename(temp_path.c_str(), path.c_str()) < 0) {
+    unlink(temp_path.c_str());
+  }
+}
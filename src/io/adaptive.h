@@ -0,0 +1,109 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SRC_IO_ADAPTIVE_H_
+#define SRC_IO_ADAPTIVE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "config/config.h"
+#include "io/device.h"
+#include "io/trace.h"
+
+#define ADAPTIVE_MAGIC 0x41424547  // "GEBA"
+#define ADAPTIVE_VERSION 1
+#define ADAPTIVE_MAX_DEVICES 16
+#define ADAPTIVE_FINGERS 5
+#define ADAPTIVE_DIRECTIONS 9
+#define ADAPTIVE_NEAR_MISS 0.6  // share of the threshold that counts as a try
+#define ADAPTIVE_RETRY_USEC 1500000
+#define ADAPTIVE_SAVE_EVERY 100
+#define ADAPTIVE_SAVE_DELAY_MS 2000  // history is written this long after it changed
+
+namespace gebaar::io {
+struct adaptive_binding {
+  uint32_t count;
+  uint32_t near_misses;
+  float mean_length;  // relative to the threshold
+  float mean_duration;  // ms
+};
+
+/*
+ * Persisted as is, so only fixed size members
+ */
+struct adaptive_device {
+  char name[TRACE_DEVICE_NAME];
+  float scale;
+  uint32_t rejections;
+  adaptive_binding bindings[ADAPTIVE_FINGERS][ADAPTIVE_DIRECTIONS];
+};
+
+/*
+ * Opt-in tuning of swipe thresholds from gesture history. A swipe that falls
+ * just short of the threshold and is followed by a successful swipe in the
+ * same direction means the user had to repeat themselves, so the device's
+ * threshold is lowered a little. Clean swipes slowly bring it back. The
+ * scale stays within the configured bounds.
+ */
+class AdaptiveThresholds {
+ public:
+  void load(const std::string& state_path,
+            const gebaar::config::Config& config);
+
+  void attach(device_state* device);
+
+  void near_miss(device_state* device, size_t fingers, size_t direction,
+                 double ratio, uint64_t time);
+
+  void success(device_state* device, size_t fingers, size_t direction,
+               double ratio, uint64_t duration, uint64_t time);
+
+  void rejected(device_state* device);
+
+  bool schedule_save();
+
+  void save();
+
+ private:
+  struct pending_retry {
+    adaptive_device* device;
+    size_t fingers;
+    size_t direction;
+    uint64_t time;
+  };
+
+  adaptive_binding* binding(adaptive_device* device, size_t fingers,
+                            size_t direction);
+
+  bool enabled = false;
+  double min_scale = 1;
+  double max_scale = 1;
+  double rate = 0;
+  std::string path;
+  std::vector<adaptive_device> entries;
+  // Device each entry is attached to, by index, nullptr for none
+  std::vector<device_state*> owners;
+  pending_retry retry{};
+  uint32_t unsaved = 0;
+  bool dirty = false;      // a change is waiting to be written
+  bool scheduled = false;  // and the caller was told to save it
+};
+}  // namespace gebaar::io
+
+#endif  // SRC_IO_ADAPTIVE_H_
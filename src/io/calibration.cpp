@@ -0,0 +1,150 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "io/calibration.h"
+#include <cstdio>
+#include <unistd.h>
+#include <cstring>
+#define FN "calibration"
+
+/**
+ * Read the calibration profile, a missing or broken file is not an error
+ *
+ * @param profile_path where the profile is read from and written to
+ */
+void gebaar::io::Calibration::load(const std::string& profile_path) {
+  path = profile_path;
+  if (path.empty() || !std::filesystem::exists(path)) {
+    return;
+  }
+  try {
+    auto table = cpptoml::parse_file(path);
+    auto device_table = table->get_table_array("device");
+    if (device_table == nullptr) {
+      return;
+    }
+    for (const auto& device : *device_table) {
+      auto name = device->get_as<std::string>("name");
+      if (!name) {
+        continue;
+      }
+      profiles[*name] = {device->get_as<double>("width").value_or(0),
+                         device->get_as<double>("height").value_or(0),
+                         device->get_as<double>("threshold_x").value_or(0),
+                         device->get_as<double>("threshold_y").value_or(0)};
+    }
+  } catch (const cpptoml::parse_exception& e) {
+    spdlog::get("main")->debug("[{}] at {} - Ignoring {}: {}", FN, __LINE__,
+                               path, e.what());
+  }
+}
+
+/**
+ * Compute the swipe thresholds of a device that was just added
+ *
+ * settings.gesture_swipe.unit selects how settings.gesture_swipe.threshold is
+ * read: "mm" is a distance on the pad, "percent" a share of the pad's width
+ * and height, "dpi" the historic factor of 1000 by 500 delta units.
+ *
+ * @param device device to calibrate, its threshold comes from the [[device]]
+ * section it matched
+ */
+void gebaar::io::Calibration::calibrate(device_state* device) {
+  std::string name = device->info.name;
+  auto known = profiles.find(name);
+  if ((device->info.width <= 0 || device->info.height <= 0) &&
+      known != profiles.end()) {
+    device->info.width = known->second.width;
+    device->info.height = known->second.height;
+  }
+
+  const auto& settings = device->config->settings;
+  double threshold = settings.gesture_swipe_threshold;
+  if (settings.gesture_swipe_unit == "mm") {
+    device->swipe_threshold_x = threshold * GESTURE_UNITS_PER_MM;
+    device->swipe_threshold_y = threshold * GESTURE_UNITS_PER_MM;
+  } else if (settings.gesture_swipe_unit == "percent" &&
+             device->info.width > 0 && device->info.height > 0) {
+    device->swipe_threshold_x =
+        threshold / 100 * device->info.width * GESTURE_UNITS_PER_MM;
+    device->swipe_threshold_y =
+        threshold / 100 * device->info.height * GESTURE_UNITS_PER_MM;
+  } else {
+    if (settings.gesture_swipe_unit == "percent") {
+      spdlog::get("main")->warn(
+          "{} does not report its size, using the dpi threshold",
+          device->info.name);
+    }
+    device->swipe_threshold_x = threshold * SWIPE_X_THRESHOLD;
+    device->swipe_threshold_y = threshold * SWIPE_Y_THRESHOLD;
+  }
+  spdlog::get("main")->debug(
+      "[{}] at {} - {}: {}x{} mm, swipe threshold {}x{}", FN, __LINE__,
+      device->info.name, device->info.width, device->info.height,
+      device->swipe_threshold_x, device->swipe_threshold_y);
+
+  if (device->info.width <= 0 || device->info.height <= 0) {
+    return;
+  }
+  profile current = {device->info.width, device->info.height,
+                     device->swipe_threshold_x, device->swipe_threshold_y};
+  if (known == profiles.end() ||
+      memcmp(&known->second, &current, sizeof(current)) != 0) {
+    profiles[name] = current;
+    save();
+  }
+}
+
+/**
+ * Escape a device name for a TOML basic string
+ */
+static std::string quote(const std::string& value) {
+  std::string quoted = "\"";
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      quoted.push_back('\\');
+    }
+    if (static_cast<unsigned char>(c) >= 0x20) {
+      quoted.push_back(c);
+    }
+  }
+  quoted.push_back('"');
+  return quoted;
+}
+
+void gebaar::io::Calibration::save() {
+  if (path.empty()) {
+    return;
+  }
+  std::string temp_path = path + ".tmp";
+  FILE* file = fopen(temp_path.c_str(), "we");
+  if (file == nullptr) {
+    return;
+  }
+  fprintf(file, "# Written by gebaard, sizes in mm, thresholds in delta units\n");
+  for (const auto& [name, p] : profiles) {
+    fprintf(file,
+            "\n[[device]]\nname = %s\nwidth = %f\nheight = %f\n"
+            "threshold_x = %f\nthreshold_y = %f\n",
+            quote(name).c_str(), p.width, p.height, p.threshold_x,
+            p.threshold_y);
+  }
+  if (fclose(file) != 0 || rename(temp_path.c_str(), path.c_str()) < 0) {
+    unlink(temp_path.c_str());
+  }
+}
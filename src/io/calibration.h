@@ -0,0 +1,59 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SRC_IO_CALIBRATION_H_
+#define SRC_IO_CALIBRATION_H_
+
+#include <map>
+#include <string>
+#include "config/config.h"
+#include "io/device.h"
+
+// Unaccelerated gesture deltas are normalized to 1000 dpi
+#define GESTURE_UNITS_PER_MM (1000 / 25.4)
+#define SWIPE_X_THRESHOLD 1000
+#define SWIPE_Y_THRESHOLD 500
+
+namespace gebaar::io {
+/*
+ * Converts the configured swipe threshold into gesture delta units for each
+ * device. Device sizes are kept in a calibration profile, so a device that
+ * can't report its size later still gets the distance it had before.
+ */
+class Calibration {
+ public:
+  void load(const std::string& profile_path);
+
+  void calibrate(device_state* device);
+
+ private:
+  struct profile {
+    double width;
+    double height;
+    double threshold_x;
+    double threshold_y;
+  };
+
+  void save();
+
+  std::string path;
+  std::map<std::string, profile> profiles;
+};
+}  // namespace gebaar::io
+
+#endif  // SRC_IO_CALIBRATION_H_
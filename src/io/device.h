@@ -0,0 +1,54 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SRC_IO_DEVICE_H_
+#define SRC_IO_DEVICE_H_
+
+#include <libinput.h>
+#include <cstdint>
+#include "config/config.h"
+#include "io/direction.h"
+#include "io/regions.h"
+#include "io/trace.h"
+
+namespace gebaar::io {
+struct adaptive_device;
+
+/*
+ * What gebaard knows about an input device. Looked up through libinput's
+ * device user data, kept after removal so trace indexes stay valid.
+ */
+struct device_state {
+  uint32_t id;
+  trace_device info;
+  struct libinput_device* device;  // nullptr once removed
+
+  // Settings and bindings of the [[device]] section it matched
+  const gebaar::config::Config::device_config* config;
+  DirectionClassifier directions;
+  TouchRegions regions;
+
+  // Gesture delta per swipe step, see Calibration
+  double swipe_threshold_x;
+  double swipe_threshold_y;
+
+  adaptive_device* adaptive;  // nullptr unless adaptive thresholds are on
+};
+}  // namespace gebaar::io
+
+#endif  // SRC_IO_DEVICE_H_
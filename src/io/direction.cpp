@@ -0,0 +1,110 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "io/direction.h"
+#include <algorithm>
+#include <cmath>
+
+// Directions of the sectors counter-clockwise from right
+static const uint8_t SECTORS_4[] = {6, 2, 4, 8};
+static const uint8_t SECTORS_8[] = {6, 3, 2, 1, 4, 7, 8, 9};
+static const uint8_t SECTORS_16[] = {6,  13, 3, 11, 2, 10, 1, 12,
+                                     4,  14, 7, 16, 8, 17, 9, 15};
+
+/**
+ * Compute the sector boundaries from the width of the axis sectors
+ *
+ * @param sectors 4, 8 or 16
+ * @param axis_width angle in degrees covered by each of the up, down, left
+ * and right sectors, the rest of a quadrant is shared evenly by the sectors
+ * between them. Ignored with 4 sectors.
+ */
+void gebaar::io::DirectionClassifier::configure(int sectors,
+                                                double axis_width) {
+  int per_quadrant = sectors == 4 ? 1 : sectors == 16 ? 4 : 2;
+  double axis = per_quadrant == 1 ? 90 : std::clamp(axis_width, 1.0, 89.0);
+  double widths[DIRECTION_MAX_SECTORS];
+  for (int i = 0; i < per_quadrant * 4; ++i) {
+    widths[i] =
+        i % per_quadrant == 0 ? axis : (90 - axis) / (per_quadrant - 1);
+  }
+  configure(per_quadrant * 4, widths);
+}
+
+/**
+ * Compute the sector boundaries from the width of every sector
+ *
+ * @param sectors 4, 8 or 16
+ * @param widths angle in degrees covered by each sector, counter-clockwise
+ * starting with right, which is centered on the horizontal axis. They add up
+ * to 360.
+ */
+void gebaar::io::DirectionClassifier::configure(int sectors,
+                                                const double* widths) {
+  const uint8_t* directions =
+      sectors == 4 ? SECTORS_4 : sectors == 16 ? SECTORS_16 : SECTORS_8;
+  sectors = sectors == 4 || sectors == 16 ? sectors : 8;
+
+  // Counter-clockwise end of each sector, in degrees from right
+  double ends[DIRECTION_MAX_SECTORS];
+  double end = -widths[0] / 2;
+  for (int i = 0; i < sectors; ++i) {
+    end += widths[i];
+    ends[i] = end;
+  }
+  auto direction_at = [&](double angle) {
+    double start = ends[sectors - 1] - 360;
+    angle = start + std::fmod(std::fmod(angle - start, 360) + 360, 360);
+    int i = 0;
+    while (i < sectors - 1 && angle >= ends[i]) {
+      ++i;
+    }
+    return directions[i];
+  };
+
+  for (int quadrant = 0; quadrant < 4; ++quadrant) {
+    bool left = quadrant & 1;
+    bool up = quadrant & 2;
+    // Angle from right of an angle in the quadrant away from its horizontal
+    // axis, and the other way round
+    double base = left ? 180 : 0;
+    double sign = left == up ? -1 : 1;
+
+    double angles[DIRECTION_MAX_SECTORS];
+    size_t count = 0;
+    for (int i = 0; i < sectors; ++i) {
+      double angle = std::fmod(std::fmod(sign * (ends[i] - base), 360) + 360,
+                               360);
+      if (angle > 0 && angle < 90) {
+        angles[count++] = angle;
+      }
+    }
+    std::sort(angles, angles + count);
+
+    boundaries[quadrant] = count;
+    double from = 0;
+    for (size_t i = 0; i <= count; ++i) {
+      double to = i < count ? angles[i] : 90;
+      table[quadrant][i] = direction_at(base + sign * (from + to) / 2);
+      if (i < count) {
+        slopes[quadrant][i] = tan(angles[i] * M_PI / 180);
+      }
+      from = to;
+    }
+  }
+}
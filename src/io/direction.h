@@ -0,0 +1,76 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SRC_IO_DIRECTION_H_
+#define SRC_IO_DIRECTION_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#define DIRECTION_MAX_SECTORS 16
+#define DIRECTION_NONE 5  // keypad middle
+
+namespace gebaar::io {
+/*
+ * Maps a swipe to one of 4, 8 or 16 sectors. Directions keep the keypad
+ * numbering (1 = left_up, 2 = up, ... 9 = right_down), the sectors between
+ * those that 16 sectors add are numbered 10 to 17, see SWIPE_COMMANDS.
+ *
+ * The sector boundaries inside each quadrant are turned into slopes when the
+ * device is added. A swipe is classified by counting the slopes of its
+ * quadrant it is above and looking that count up in the table of the
+ * quadrant, so there is no trigonometry or division per swipe.
+ */
+class DirectionClassifier {
+ public:
+  DirectionClassifier() { configure(8, 45); }
+
+  void configure(int sectors, double axis_width);
+  void configure(int sectors, const double* widths);
+
+  size_t classify(double x, double y) const {
+    double ax = x < 0 ? -x : x;
+    double ay = y < 0 ? -y : y;
+    size_t quadrant = (x < 0) | (y < 0) << 1;
+    size_t crossed = 0;
+    for (size_t i = 0; i < boundaries[quadrant]; ++i) {
+      crossed += ay >= ax * slopes[quadrant][i];
+    }
+    return table[quadrant][crossed];
+  }
+
+  static bool diagonal(size_t direction) {
+    return direction == 1 || direction == 3 || direction == 7 ||
+           direction == 9;
+  }
+
+  static bool vertical(size_t direction) {
+    return direction == 2 || direction == 8 || direction == 10 ||
+           direction == 11 || direction == 16 || direction == 17;
+  }
+
+ private:
+  // By quadrant (bit 0: left, bit 1: up), away from the horizontal axis
+  size_t boundaries[4];
+  double slopes[4][DIRECTION_MAX_SECTORS];
+  // By quadrant and boundaries crossed
+  uint8_t table[4][DIRECTION_MAX_SECTORS + 1];
+};
+}  // namespace gebaar::io
+
+#endif  // SRC_IO_DIRECTION_H_
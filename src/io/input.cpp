@@ -17,18 +17,50 @@
 */
 
 #include "input.h"
-#include <poll.h>
+#include <sys/signalfd.h>
+#include <algorithm>
+#include <cmath>
+#include <csignal>
+#include <ctime>
+#include "utils/alloc_audit.h"
+#include "utils/probes.h"
+#include "utils/xdg.h"
 
-bool runproc(const char* cmdline) {
-  if (strlen(cmdline) > 0) {
+namespace {
+// Attached inputs, one per seat. SIGUSR1 is consumed by whichever signalfd
+// is read first, so that one dumps every seat.
+std::vector<gebaar::io::Input*> attached_inputs;
+
+// Binding types of hold commands
+const std::string HOLD_GESTURE = "GESTURE";
+const std::string HOLD_TOUCH = "TOUCH";
+}  // namespace
+
+/**
+ * Hand a configured command to the supervisor
+ *
+ * @param command command to run
+ * @param fields what the command's placeholders are filled in with
+ * @return bool true if a command is configured, even if the supervisor
+ * dropped it because an earlier instance is still running
+ */
+bool gebaar::io::Input::runproc(const gebaar::config::CommandTemplate& command,
+                                const gebaar::config::gesture_fields& fields) {
+  if (!command.empty()) {
+    const std::string* cmdline = &command.text();
+    if (command.parameterized()) {
+      command.render(fields, &command_line);
+      cmdline = &command_line;
+    }
     spdlog::get("main")->info(
         "[{}] at {} - {} - Executing '{}'",
-        FN, __LINE__, __func__, cmdline);
-    int status = std::system(cmdline);
-    if (status != 0) {
-      spdlog::get("main")->warn("{} -> Non-zero exit code: {}", cmdline,
-                                 WEXITSTATUS(status));
-    }
+        FN, __LINE__, __func__, *cmdline);
+    event_command = &command.text();
+    ++commands;
+    // Replays have no supervisor, commands are only recorded
+    bool spawned = supervisor == nullptr ||
+                   supervisor->spawn(command.text(), *cmdline);
+    record_decision(TRACE_COMMAND, spawned ? 1 : 0);
     return true;
   } else {
     return false;
@@ -40,12 +72,29 @@ bool runproc(const char* cmdline) {
  * pointer
  *
  * @param config_ptr shared pointer to configuration object
+ * @param supervisor_ptr shared pointer to the supervisor running commands,
+ * nullptr when replaying a trace
+ * @param seat_name seat whose devices are handled
  */
 gebaar::io::Input::Input(
-    std::shared_ptr<gebaar::config::Config> const& config_ptr) {
+    std::shared_ptr<gebaar::config::Config> const& config_ptr,
+    std::shared_ptr<gebaar::process::Supervisor> const& supervisor_ptr,
+    const std::string& seat_name) {
   config = config_ptr;
+  supervisor = supervisor_ptr;
+  seat = seat_name;
+  libinput = nullptr;
+  udev = nullptr;
   gesture_swipe_event = {};
   touch_swipe_event = {};
+  touch_swipe_event.untracked_slot = -1;
+  touch_swipe_event.down_slots.reserve(TOUCH_MAX_SLOTS);
+  touch_swipe_event.up_slots.reserve(TOUCH_MAX_SLOTS);
+  command_line.reserve(COMMAND_LINE_RESERVE);
+  touch_frame = {};
+  touch_pinch_event = {};
+  hold_event = {};
+  drag_event = {};
   gesture_pinch_event = {};
   gesture_pinch_event.scale = DEFAULT_SCALE;
 }
@@ -57,74 +106,128 @@ gebaar::io::Input::Input(
  */
 bool gebaar::io::Input::initialize_context() {
   udev = udev_new();
-  libinput = libinput_udev_create_context(&libinput_interface, nullptr, udev);
-  return libinput_udev_assign_seat(libinput, "seat0") == 0;
+  libinput = libinput_udev_create_context(&libinput_interface, this, udev);
+  libinput_log_set_handler(libinput, log_handler);
+  libinput_log_set_priority(libinput, LIBINPUT_LOG_PRIORITY_INFO);
+  return libinput_udev_assign_seat(libinput, seat.c_str()) == 0;
 }
 
-size_t gebaar::io::Input::get_swipe_type(double sdx, double sdy) {
-  double x = sdx;
-  double y = sdy;
-  size_t swipe_type = 5;               // middle = no swipe
-                                       // 1 = left_up, 2 = up, 3 = right_up...
-                                       // 1 2 3
-                                       // 4 5 6
-                                       // 7 8 9
-  const double OBLIQUE_RATIO = 0.414;  // =~ tan(22.5);
-
-  if (abs(x) > abs(y)) {
-    // left or right swipe
-    swipe_type += x < 0 ? -1 : 1;
-
-    // check for oblique swipe
-    if (abs(y) / abs(x) > OBLIQUE_RATIO) {
-      swipe_type += y < 0 ? -3 : 3;
-    }
-  } else {
-    // up of down swipe
-    swipe_type += y < 0 ? -3 : 3;
+/**
+ * Route libinput's log into ours, it would go to stderr and be lost once
+ * daemonized. Reports of libinput falling behind are counted, they mean the
+ * loop was blocked.
+ */
+void gebaar::io::Input::log_handler(struct libinput* context,
+                                    enum libinput_log_priority priority,
+                                    const char* format, va_list args) {
+  auto input = static_cast<Input*>(libinput_get_user_data(context));
+  char message[512];
+  vsnprintf(message, sizeof(message), format, args);
+  size_t length = strlen(message);
+  if (length > 0 && message[length - 1] == '\n') {
+    message[length - 1] = '\0';
+  }
 
-    // check for oblique swipe
-    if (abs(x) / abs(y) > OBLIQUE_RATIO) {
-      swipe_type += x < 0 ? -1 : 1;
-    }
+  const char* lagging = strstr(message, "lagging behind by ");
+  if (input != nullptr && lagging != nullptr) {
+    uint64_t ms = strtoul(lagging + strlen("lagging behind by "), nullptr, 10);
+    auto& lag = input->lag;
+    ++lag.libinput_reports;
+    lag.libinput_total_ms += ms;
+    lag.libinput_max_ms = std::max(lag.libinput_max_ms, ms);
+    input->record_decision(TRACE_LAG, LAG_LIBINPUT, ms);
+  }
+  if (input != nullptr && strstr(message, "client bug") != nullptr) {
+    ++input->lag.client_bugs;
+  }
+
+  if (priority >= LIBINPUT_LOG_PRIORITY_ERROR) {
+    spdlog::get("main")->error("libinput: {}", message);
+  } else if (priority >= LIBINPUT_LOG_PRIORITY_INFO) {
+    spdlog::get("main")->info("libinput: {}", message);
+  } else {
+    spdlog::get("main")->debug("libinput: {}", message);
   }
-  return swipe_type;
+}
+
+/**
+ * Direction of a swipe on the device the current event came from
+ *
+ * @param sdx horizontal distance
+ * @param sdy vertical distance, negative is up
+ * @return size_t see DirectionClassifier
+ */
+size_t gebaar::io::Input::get_swipe_type(double sdx, double sdy) {
+  return current_device->directions.classify(sdx, sdy);
+}
+
+/**
+ * Factor adaptive tuning currently applies to the device's swipe thresholds
+ */
+static double threshold_scale(const gebaar::io::device_state& device) {
+  return device.adaptive ? device.adaptive->scale : 1;
 }
 
 bool gebaar::io::Input::test_above_threshold(size_t swipe_type, double length,
-                                             libinput_device* dev) {
-  double w = 0;
-  double h = 0;
-  libinput_device_get_size(dev, &w, &h);
+                                             device_state* dev,
+                                             double* ratio) {
+  double w = dev->info.width * threshold_scale(*dev);
+  double h = dev->info.height * threshold_scale(*dev);
 
   size_t dim;
-  if (swipe_type % 2 != 0) {
+  if (DirectionClassifier::diagonal(swipe_type)) {
     double d = hypot(w, h);
-    dim = d * config->settings.touch_longswipe_screen_percentage / 100;
-  } else if (swipe_type < 4 || swipe_type > 6) {
-    dim = h * config->settings.touch_longswipe_screen_percentage / 100;
+    dim = d * device_config().settings.touch_longswipe_screen_percentage / 100;
+  } else if (DirectionClassifier::vertical(swipe_type)) {
+    dim = h * device_config().settings.touch_longswipe_screen_percentage / 100;
   } else {
-    dim = w * config->settings.touch_longswipe_screen_percentage / 100;
+    dim = w * device_config().settings.touch_longswipe_screen_percentage / 100;
   }
 
   spdlog::get("main")->debug(
       "percentage {}, required length {}, actual length {}",
-      config->settings.touch_longswipe_screen_percentage, dim, length);
-  return (length > dim);
+      device_config().settings.touch_longswipe_screen_percentage, dim, length);
+  *ratio = dim > 0 ? length / dim : 0;
+  if (length > dim) {
+    record_decision(TRACE_THRESHOLD, TRACE_SWIPE, swipe_type, 1);
+    return true;
+  }
+  adaptive.near_miss(dev, 1, swipe_type, *ratio, current_time);
+  return false;
 }
 
-void gebaar::io::Input::apply_swipe(size_t swipe_type, size_t fingers, std::string type) {
-  std::string command;
-  if (strcmp(type.c_str(), "TOUCH") == 0) {
-    command = config->get_swipe_command(fingers, "TOUCH", swipe_type);
-  } else {
-    command = config->get_swipe_command(fingers, "GESTURE", swipe_type);
+/**
+ * Run the command bound to a swipe
+ *
+ * @param swipe_type direction, see DirectionClassifier
+ * @param fingers fingers the swipe was made with
+ * @param type GESTURE or TOUCH
+ * @param fields placeholder values
+ * @param region_type binding type of the touchscreen region the swipe
+ * started in, its commands take precedence over those of type
+ */
+void gebaar::io::Input::apply_swipe(size_t swipe_type, size_t fingers,
+                                    const std::string& type,
+                                    gebaar::config::gesture_fields fields,
+                                    const std::string* region_type) {
+  const auto* command =
+      &device_config().get_swipe_command(fingers, type, swipe_type);
+  if (region_type != nullptr) {
+    const auto& in_region =
+        device_config().get_swipe_command(fingers, *region_type, swipe_type);
+    if (!in_region.empty()) {
+      command = &in_region;
+    }
   }
   spdlog::get("main")->debug(
-      "[{}] at {} - {} - fingers: {}, type: {}, gesture: {} ... ",
-      FN, __LINE__, __func__, fingers, type,
+      "[{}] at {} - {} - fingers: {}, type: {}, gesture: SWIPE, direction: {} ... ",
+      FN, __LINE__, __func__, fingers,
+      region_type != nullptr ? *region_type : type,
       config->get_swipe_type_name(swipe_type));
-  runproc(command.c_str());
+  record_decision(TRACE_GESTURE, TRACE_SWIPE, swipe_type, fingers);
+  fields.fingers = fingers;
+  fields.direction = &config->get_swipe_type_name(swipe_type);
+  runproc(*command, fields);
 }
 
 /**
@@ -139,12 +242,10 @@ void gebaar::io::Input::apply_swipe(size_t swipe_type, size_t fingers, std::stri
  * @param slots Represents pair(finger, timeoftouch(down/lift))
  */
 void gebaar::io::Input::check_multitouch_down_up(
-    std::vector<std::pair<size_t, double>> slots) {
+    const std::vector<std::pair<size_t, double>>& slots) {
   if (slots.size() > 1) {
-    std::vector<std::pair<size_t, double>>::reverse_iterator iter =
-        slots.rbegin();
-    std::vector<std::pair<size_t, double>>::reverse_iterator prev_iter =
-        std::next(iter, 1);
+    auto iter = slots.rbegin();
+    auto prev_iter = std::next(iter, 1);
     double timebetweenslots = iter->second - prev_iter->second;
     if (timebetweenslots <= THRESH) {
       touch_swipe_event.fingers = slots.size();
@@ -159,12 +260,24 @@ void gebaar::io::Input::check_multitouch_down_up(
  * It passes a list of pairs (slot_id, timestamp) to check_multitouch_down_up
  * Each slot corresponds to a finger touched down on the screen
  *
- * @param tev Touch Event
+ * @param ev Touch Event
  */
-void gebaar::io::Input::handle_touch_event_down(libinput_event_touch* tev) {
-  touch_swipe_event.down_slots.push_back(std::pair<size_t, double>(
-      libinput_event_touch_get_slot(tev), libinput_event_touch_get_time(tev)));
+void gebaar::io::Input::handle_touch_event_down(const raw_event& ev) {
+  if (ev.slot >= TOUCH_MAX_SLOTS && touch_swipe_event.untracked_slot < 0) {
+    spdlog::get("main")->debug(
+        "[{}] at {} - {}: slot {} is not tracked, the gesture is rejected", FN,
+        __LINE__, __func__, ev.slot);
+    touch_swipe_event.untracked_slot = ev.slot;
+  }
+  touch_swipe_event.down_slots.push_back(
+      std::pair<size_t, double>(ev.slot, ev.time / 1000));
   check_multitouch_down_up(touch_swipe_event.down_slots);
+  if (touch_swipe_event.down_slots.size() == 1) {
+    touch_swipe_event.region = current_device->regions.locate(
+        ev.x, ev.y, current_device->info.width, current_device->info.height);
+  }
+  touch_pinch_down(ev, ev.slot < 0 ? 0 : ev.slot);
+  start_hold(ev, touch_swipe_event.down_slots.size(), true);
 }
 
 /**
@@ -172,107 +285,272 @@ void gebaar::io::Input::handle_touch_event_down(libinput_event_touch* tev) {
  * It passes a list of pairs (slot_id, timestamp) to check_multitouch_down_up
  * Each slot corresponds to a finger lifted from the screen
  *
- * If all the fingers are lifted, we check the swipe type of all fingers,
- * If all fingers swipe in the same direction, success
+ * The gesture is checked once the frame the lift belongs to is complete
  *
- * @param tev Touch Event
+ * @param ev Touch Event
  */
-void gebaar::io::Input::handle_touch_event_up(libinput_event_touch* tev) {
-  touch_swipe_event.up_slots.push_back(std::pair<size_t, double>(
-      libinput_event_touch_get_slot(tev), libinput_event_touch_get_time(tev)));
+void gebaar::io::Input::handle_touch_event_up(const raw_event& ev) {
+  touch_swipe_event.up_slots.push_back(
+      std::pair<size_t, double>(ev.slot, ev.time / 1000));
   check_multitouch_down_up(touch_swipe_event.up_slots);
+  touch_frame.lifted = true;
+  touch_pinch_event.active = false;
+  if (hold_event.touch) {
+    stop_hold();
+  }
+}
 
-  bool a =
-      touch_swipe_event.up_slots.size() == touch_swipe_event.down_slots.size();
-
-  if (a) {
-    std::vector<size_t> swipes;
-    size_t swipe_type;
-    size_t slot;
-    double dx;
-    double dy;
-    double swipe_length;
-    for (auto iter = touch_swipe_event.delta_xy.begin();
-         iter != touch_swipe_event.delta_xy.end(); iter++) {
-      slot = iter->first;
-      dx = iter->second.first;
-      dy = iter->second.second;
-      swipe_length = get_swipe_length(dx, dy);
-      libinput_device* dev =
-          libinput_event_get_device(libinput_event_touch_get_base_event(tev));
-      swipe_type = get_swipe_type(dx, dy);
-
-      if (touch_swipe_event.fingers == 1) {
-        if (!test_above_threshold(swipe_type, swipe_length, dev)) {
-          spdlog::get("main")->debug("swipe not above threshold");
-          break;
-        } else {
-          spdlog::get("main")->debug("swipe above threshold");
-        }
+/**
+ * This event ends a hardware frame. Motion of every slot in the frame is
+ * applied at once, then, if all the fingers are lifted, the gesture is checked
+ *
+ * @param ev Touch Event
+ */
+void gebaar::io::Input::handle_touch_event_frame(const raw_event& ev) {
+  for (size_t slot = 0; slot < TOUCH_MAX_SLOTS; ++slot) {
+    if (touch_frame.moved[slot]) {
+      move_touch_slot(slot, touch_frame.x[slot], touch_frame.y[slot]);
+    }
+  }
+  if (touch_pinch_event.active) {
+    touch_pinch_frame(ev);
+  }
+  if (hold_event.active && hold_event.touch) {
+    for (size_t slot = 0; slot < TOUCH_MAX_SLOTS; ++slot) {
+      const auto& delta = touch_swipe_event.delta_xy[slot];
+      if (touch_frame.moved[slot] &&
+          hypot(delta.first, delta.second) > HOLD_TOUCH_TOLERANCE) {
+        stop_hold();
+        break;
       }
-
+    }
+  }
+  bool lifted = touch_frame.lifted;
+  touch_frame = {};
+  if (lifted && touch_swipe_event.up_slots.size() ==
+                    touch_swipe_event.down_slots.size()) {
+    if (touch_pinch_event.recognized || touch_swipe_event.held) {
       spdlog::get("main")->debug(
-          "[{}] at {} - {}, slot: {}, swipe-type: {}, length: {}", FN, __LINE__,
-          __func__, slot, config->get_swipe_type_name(swipe_type),
-          swipe_length);
+          "[{}] at {} - {}: touch gesture was a pinch or hold", FN, __LINE__,
+          __func__);
+      reset_touch_swipe_event();
+    } else {
+      finish_touch_swipe(ev);
+    }
+  }
+}
+
+/**
+ * Take the first two fingers on a touchscreen as a pinch. The second one
+ * touching down begins it, a third one ends it.
+ *
+ * @param ev touch down
+ * @param slot slot of the finger
+ */
+void gebaar::io::Input::touch_pinch_down(const raw_event& ev, size_t slot) {
+  touch_pinch_event.active = false;
+  if (touch_pinch_event.fingers >= 2) {
+    ++touch_pinch_event.fingers;
+    return;
+  }
+  size_t finger = touch_pinch_event.fingers++;
+  touch_pinch_event.slots[finger] = slot;
+  touch_pinch_event.x[finger] = ev.x;
+  touch_pinch_event.y[finger] = ev.y;
+  if (finger == 0) {
+    return;
+  }
+  double dx = touch_pinch_event.x[1] - touch_pinch_event.x[0];
+  double dy = touch_pinch_event.y[1] - touch_pinch_event.y[0];
+  touch_pinch_event.start_distance = hypot(dx, dy);
+  touch_pinch_event.angle = atan2(dy, dx);
+  if (touch_pinch_event.start_distance > 0) {
+    touch_pinch_event.active = true;
+    raw_event begin = ev;
+    begin.fingers = 2;
+    handle_pinch_event(begin, true);
+  }
+}
+
+/**
+ * Turn the frame's motion of the two fingers into the scale and angle delta
+ * a touchpad would report, and recognize them like a touchpad pinch
+ *
+ * @param ev touch frame
+ */
+void gebaar::io::Input::touch_pinch_frame(const raw_event& ev) {
+  bool moved = false;
+  for (size_t finger = 0; finger < 2; ++finger) {
+    size_t slot = touch_pinch_event.slots[finger];
+    if (slot < TOUCH_MAX_SLOTS && touch_frame.moved[slot]) {
+      touch_pinch_event.x[finger] = touch_frame.x[slot];
+      touch_pinch_event.y[finger] = touch_frame.y[slot];
+      moved = true;
+    }
+  }
+  if (!moved) {
+    return;
+  }
+  double dx = touch_pinch_event.x[1] - touch_pinch_event.x[0];
+  double dy = touch_pinch_event.y[1] - touch_pinch_event.y[0];
+  double angle = atan2(dy, dx);
+  // y grows downwards, so a growing angle turns clockwise like libinput's
+  double delta = angle - touch_pinch_event.angle;
+  if (delta > M_PI) {
+    delta -= 2 * M_PI;
+  } else if (delta < -M_PI) {
+    delta += 2 * M_PI;
+  }
+  touch_pinch_event.angle = angle;
 
-      if (!swipes.empty() && swipe_type != swipes.back()) {
+  raw_event update = ev;
+  update.fingers = 2;
+  update.scale = hypot(dx, dy) / touch_pinch_event.start_distance;
+  update.angle = delta * 180 / M_PI;
+  // Only a pinch that ran a command takes the gesture from a swipe, unbound
+  // pinches step through without running anything
+  uint64_t before = commands;
+  handle_pinch_event(update, false);
+  if (commands != before) {
+    touch_pinch_event.recognized = true;
+  }
+}
+
+/**
+ * libinput took the touches away from us (e.g. a palm was detected).
+ * Everything seen since the first finger went down is dropped.
+ */
+void gebaar::io::Input::handle_touch_event_cancel() {
+  if (!touch_swipe_event.down_slots.empty()) {
+    record_decision(TRACE_REJECT, REJECT_CANCELLED);
+  }
+  reset_touch_swipe_event();
+  touch_frame = {};
+  stop_hold();
+  spdlog::get("main")->debug("[{}] at {} - {}: touch gesture cancelled", FN,
+                             __LINE__, __func__);
+}
+
+/**
+ * If all the fingers are lifted, we check the swipe type of all fingers,
+ * If all fingers swipe in the same direction, success
+ *
+ * @param ev Touch Event that completed the gesture
+ */
+void gebaar::io::Input::finish_touch_swipe(const raw_event& ev) {
+  if (touch_swipe_event.untracked_slot >= 0) {
+    record_decision(TRACE_REJECT, REJECT_UNTRACKED_SLOT,
+                    touch_swipe_event.untracked_slot);
+    reset_touch_swipe_event();
+    return;
+  }
+  size_t swipes = 0;
+  double ratio = 1;
+  size_t swipe_type = 0;
+  size_t previous_type = 0;
+  // Summed over the fingers that swiped, {dx} and {dy} get their mean
+  double sum_dx = 0;
+  double sum_dy = 0;
+  for (size_t slot = 0; slot < TOUCH_MAX_SLOTS; ++slot) {
+    if (!touch_swipe_event.moved[slot]) {
+      continue;
+    }
+    double dx = touch_swipe_event.delta_xy[slot].first;
+    double dy = touch_swipe_event.delta_xy[slot].second;
+    double swipe_length = get_swipe_length(dx, dy);
+    swipe_type = get_swipe_type(dx, dy);
+
+    if (touch_swipe_event.fingers == 1) {
+      if (!test_above_threshold(swipe_type, swipe_length,
+                                devices[ev.device].get(), &ratio)) {
+        spdlog::get("main")->debug("swipe not above threshold");
+        record_decision(TRACE_REJECT, REJECT_BELOW_THRESHOLD, swipe_type);
         break;
+      } else {
+        spdlog::get("main")->debug("swipe above threshold");
       }
+    }
 
-      swipes.push_back(swipe_type);
+    spdlog::get("main")->debug(
+        "[{}] at {} - {}, slot: {}, swipe-type: {}, length: {}", FN, __LINE__,
+        __func__, slot, config->get_swipe_type_name(swipe_type),
+        swipe_length);
+
+    if (swipes > 0 && swipe_type != previous_type) {
+      record_decision(TRACE_REJECT, REJECT_DIRECTION_MISMATCH, swipe_type);
+      break;
     }
 
-    /*
-      1) Check number of down slots equals
-      calculated number of fingers (check_multi_touch_downup). This prevents
-      swipes when fingers are added too late or lifted too early
+    previous_type = swipe_type;
+    sum_dx += dx;
+    sum_dy += dy;
+    ++swipes;
+  }
+
+  /*
+    1) Check number of down slots equals
+    calculated number of fingers (check_multi_touch_downup). This prevents
+    swipes when fingers are added too late or lifted too early
 
-      2) Check number down slots equals number of touches sensed moving across
-      the screen. This prevents swipes where the fingers are lifted and placed
-      back on the screen before the touch_swipe_event structure is refreshed
-      (causing additional downslots)
+    2) Check number down slots equals number of touches sensed moving across
+    the screen. This prevents swipes where the fingers are lifted and placed
+    back on the screen before the touch_swipe_event structure is refreshed
+    (causing additional downslots)
 
-      3) Check number of valid swipes (each finger of multi touch
-      swipe) equals calculated number of fingers. This only allows swipes
-      where all swiping fingers are going in the same direction
-    */
-    bool is_valid_gesture = true;
+    3) Check number of valid swipes (each finger of multi touch
+    swipe) equals calculated number of fingers. This only allows swipes
+    where all swiping fingers are going in the same direction
+  */
+  bool is_valid_gesture = true;
+  is_valid_gesture =
+      (is_valid_gesture &&
+       (touch_swipe_event.down_slots.size() == touch_swipe_event.fingers));
+  if (!is_valid_gesture) {
+    spdlog::get("main")->info("down slots do not match number of fingers");
+    record_decision(TRACE_REJECT, REJECT_FINGER_COUNT);
+  } else {
     is_valid_gesture =
-        (is_valid_gesture &&
-         (touch_swipe_event.down_slots.size() == touch_swipe_event.fingers));
+        (is_valid_gesture && (touch_swipe_event.down_slots.size() ==
+                              touch_swipe_event.moved_slots));
     if (!is_valid_gesture) {
-      spdlog::get("main")->info("down slots do not match number of fingers");
+      spdlog::get("main")->info("down slots do not match motion slots");
+      record_decision(TRACE_REJECT, REJECT_MOTION_SLOTS);
     } else {
       is_valid_gesture =
-          (is_valid_gesture && (touch_swipe_event.down_slots.size() ==
-                                touch_swipe_event.delta_xy.size()));
+          (is_valid_gesture && (swipes == touch_swipe_event.fingers));
       if (!is_valid_gesture) {
-        spdlog::get("main")->info("down slots do not match motion slots");
+        spdlog::get("main")->info(
+            "number of valid swipes {} do not match number of fingers {}",
+            swipes, touch_swipe_event.fingers);
+        record_decision(TRACE_REJECT, REJECT_SWIPE_COUNT, swipes);
       } else {
-        is_valid_gesture =
-            (is_valid_gesture && (swipes.size() == touch_swipe_event.fingers));
-        if (!is_valid_gesture) {
-          spdlog::get("main")->info(
-              "number of valid swipes {} do not match number of fingers {}",
-              swipes.size(), touch_swipe_event.fingers);
-        } else {
-          apply_swipe(swipe_type, touch_swipe_event.fingers, swipe_event_group);
-        }
+        uint64_t down_time = touch_swipe_event.down_slots.front().second;
+        adaptive.success(devices[ev.device].get(), touch_swipe_event.fingers,
+                         swipe_type, ratio, current_time - down_time * 1000,
+                         current_time);
+        schedule_adaptive_save();
+        gebaar::config::gesture_fields fields;
+        fields.step = 1;
+        fields.dx = sum_dx / swipes;
+        fields.dy = sum_dy / swipes;
+        fields.duration_ms = current_time / 1000 - down_time;
+        apply_swipe(swipe_type, touch_swipe_event.fingers, swipe_event_group,
+                    fields,
+                    touch_swipe_event.region != nullptr
+                        ? &touch_swipe_event.region->binding
+                        : nullptr);
       }
     }
-
-    spdlog::get("main")->debug(
-        "[{}] at {} - {}, fgrs: {}, d-slts: {}, u-slts: {}, d-xy: {}, "
-        "prv-xy: "
-        "{}",
-        FN, __LINE__, __func__, touch_swipe_event.fingers,
-        touch_swipe_event.down_slots.size(), touch_swipe_event.up_slots.size(),
-        touch_swipe_event.delta_xy.size(), touch_swipe_event.prev_xy.size());
-    touch_swipe_event = {};
-    spdlog::get("main")->debug("[{}] at {} - {}: touch gesture finished\n\n",
-                               FN, __LINE__, __func__);
   }
+
+  spdlog::get("main")->debug(
+      "[{}] at {} - {}, fgrs: {}, d-slts: {}, u-slts: {}, mvd-slts: {}", FN,
+      __LINE__, __func__, touch_swipe_event.fingers,
+      touch_swipe_event.down_slots.size(), touch_swipe_event.up_slots.size(),
+      touch_swipe_event.moved_slots);
+  reset_touch_swipe_event();
+  spdlog::get("main")->debug("[{}] at {} - {}: touch gesture finished\n\n",
+                             FN, __LINE__, __func__);
 }
 
 double gebaar::io::Input::get_swipe_length(double sdx, double sdy) {
@@ -280,45 +558,46 @@ double gebaar::io::Input::get_swipe_length(double sdx, double sdy) {
 }
 
 /**
- * This event occurs when a finger moves on the touchscreen
- * mimics handle_swipe_event_with_coords but for multiple tracks (each touched
+ * This event occurs when a finger moves on the touchscreen. Only the last
+ * position of a slot within a frame matters, it is applied on TOUCH_FRAME.
+ *
+ * @param ev Touch Event
+ */
+void gebaar::io::Input::handle_touch_event_motion(const raw_event& ev) {
+  // Single touch devices report slot -1
+  size_t slot = ev.slot < 0 ? 0 : ev.slot;
+  if (slot < TOUCH_MAX_SLOTS) {
+    touch_frame.moved[slot] = true;
+    touch_frame.x[slot] = ev.x;
+    touch_frame.y[slot] = ev.y;
+  }
+}
+
+/**
+ * Mimics handle_swipe_event_with_coords but for multiple tracks (each touched
  * down finger)
  *
  * libinput touch event has no get_dx, get_dy functions. Store previous
  * coordinates to acquire dx and dy
  *
- * @param tev Touch Event
- */
-void gebaar::io::Input::handle_touch_event_motion(libinput_event_touch* tev) {
-  if (touch_swipe_event.delta_xy.find(libinput_event_touch_get_slot(tev)) ==
-      touch_swipe_event.delta_xy.end()) {
-    touch_swipe_event.delta_xy.insert(
-        std::pair<size_t, std::pair<double, double>>(
-            libinput_event_touch_get_slot(tev), {0, 0}));
-    touch_swipe_event.prev_xy.insert(
-        std::pair<size_t, std::pair<double, double>>(
-            libinput_event_touch_get_slot(tev),
-            {libinput_event_touch_get_x(tev),
-             libinput_event_touch_get_y(tev)}));
+ * @param slot finger the position belongs to
+ * @param x position in mm
+ * @param y position in mm
+ */
+void gebaar::io::Input::move_touch_slot(size_t slot, double x, double y) {
+  std::pair<double, double>& delta = touch_swipe_event.delta_xy[slot];
+  std::pair<double, double>& prevcoord = touch_swipe_event.prev_xy[slot];
+  if (!touch_swipe_event.moved[slot]) {
+    touch_swipe_event.moved[slot] = true;
+    ++touch_swipe_event.moved_slots;
+    delta = {0, 0};
   } else {
-    std::pair<double, double> prevcoord =
-        touch_swipe_event.prev_xy.find(libinput_event_touch_get_slot(tev))
-            ->second;
-    double prevx = prevcoord.first;
-    double prevy = prevcoord.second;
-    touch_swipe_event.delta_xy.find(libinput_event_touch_get_slot(tev))
-        ->second.first += (libinput_event_touch_get_x(tev) - prevx);
-    touch_swipe_event.delta_xy.find(libinput_event_touch_get_slot(tev))
-        ->second.second += (libinput_event_touch_get_y(tev) - prevy);
-    touch_swipe_event.prev_xy.find(libinput_event_touch_get_slot(tev))->second =
-        {libinput_event_touch_get_x(tev), libinput_event_touch_get_y(tev)};
-    spdlog::get("main")->debug(
-        "[{}] at {} - {} dx: {} , dy: {}", FN, __LINE__, __func__,
-        touch_swipe_event.delta_xy.find(libinput_event_touch_get_slot(tev))
-            ->second.first,
-        touch_swipe_event.delta_xy.find(libinput_event_touch_get_slot(tev))
-            ->second.second);
+    delta.first += (x - prevcoord.first);
+    delta.second += (y - prevcoord.second);
+    spdlog::get("main")->debug("[{}] at {} - {} dx: {} , dy: {}", FN,
+                               __LINE__, __func__, delta.first, delta.second);
   }
+  prevcoord = {x, y};
 }
 
 /**
@@ -329,6 +608,26 @@ void gebaar::io::Input::reset_swipe_event() {
   gesture_swipe_event.executed = false;
 }
 
+/**
+ * Reset touch swipe event struct to defaults, keeping the memory of the slot
+ * lists
+ */
+void gebaar::io::Input::reset_touch_swipe_event() {
+  touch_swipe_event.fingers = 0;
+  touch_swipe_event.x = 0;
+  touch_swipe_event.y = 0;
+  for (size_t slot = 0; slot < TOUCH_MAX_SLOTS; ++slot) {
+    touch_swipe_event.moved[slot] = false;
+  }
+  touch_swipe_event.moved_slots = 0;
+  touch_swipe_event.region = nullptr;
+  touch_swipe_event.held = false;
+  touch_swipe_event.untracked_slot = -1;
+  touch_swipe_event.down_slots.clear();
+  touch_swipe_event.up_slots.clear();
+  touch_pinch_event = {};
+}
+
 /**
  * Reset pinch event struct to defaults
  */
@@ -341,6 +640,76 @@ void gebaar::io::Input::reset_pinch_event() {
   gesture_pinch_event.angle = 0;
 }
 
+/**
+ * Placeholder values of a pinch or rotate command
+ *
+ * @param pinch_type index into PINCH_COMMANDS
+ * @param scale scale the command is triggered at
+ * @param angle angle the command is triggered at
+ */
+gebaar::config::gesture_fields gebaar::io::Input::pinch_fields(
+    size_t pinch_type, double scale, double angle) {
+  gebaar::config::gesture_fields fields;
+  fields.fingers = gesture_pinch_event.fingers;
+  fields.direction = &PINCH_COMMANDS.at(pinch_type);
+  fields.step =
+      gesture_pinch_event.step == 0 ? 1 : abs(gesture_pinch_event.step);
+  fields.scale = scale;
+  fields.angle = angle;
+  fields.duration_ms = (current_time - gesture_pinch_event.start_time) / 1000;
+  return fields;
+}
+
+/**
+ * Record a pinch or rotation crossing its threshold, which is the gesture
+ *
+ * @param pinch_type index into PINCH_COMMANDS
+ */
+void gebaar::io::Input::record_pinch(size_t pinch_type) {
+  record_decision(TRACE_THRESHOLD, TRACE_PINCH, pinch_type,
+                  gesture_pinch_event.fingers);
+  record_decision(TRACE_GESTURE, TRACE_PINCH, pinch_type,
+                  gesture_pinch_event.fingers);
+}
+
+/**
+ * Lock a pinch gesture in as a pinch, a rotation or both, comparing how far
+ * it got towards each threshold. One has to lead the other by
+ * settings.pinch.intent_hysteresis to win alone. The decision waits for
+ * settings.pinch.intent_updates updates, unless a threshold is reached
+ * earlier.
+ *
+ * @param new_scale scale since the gesture began
+ * @param new_angle angle since the gesture began
+ */
+void gebaar::io::Input::classify_pinch_intent(double new_scale,
+                                              double new_angle) {
+  const auto& settings = device_config().settings;
+  if (settings.pinch_intent_updates <= 0) {
+    gesture_pinch_event.intent = INTENT_BOTH;
+    return;
+  }
+  double pinch = std::fabs(new_scale - 1) / settings.pinch_threshold;
+  double rotate = std::fabs(new_angle) / settings.rotate_threshold;
+  ++gesture_pinch_event.updates;
+  bool settled = gesture_pinch_event.updates >= settings.pinch_intent_updates &&
+                 std::max(pinch, rotate) >= PINCH_INTENT_MIN_PROGRESS;
+  if (!settled && pinch < 1 && rotate < 1) {
+    return;
+  }
+  if (pinch > rotate * settings.pinch_intent_hysteresis) {
+    gesture_pinch_event.intent = INTENT_PINCH;
+  } else if (rotate > pinch * settings.pinch_intent_hysteresis) {
+    gesture_pinch_event.intent = INTENT_ROTATE;
+  } else {
+    gesture_pinch_event.intent = INTENT_BOTH;
+  }
+  spdlog::get("main")->debug(
+      "[{}] at {} - {}: intent {} after {} updates, pinch {} rotate {}", FN,
+      __LINE__, __func__, static_cast<int>(gesture_pinch_event.intent),
+      gesture_pinch_event.updates, pinch, rotate);
+}
+
 /**
  * Pinch one_shot gesture handle
  * @param new_scale last reported scale between the fingers
@@ -350,12 +719,13 @@ void gebaar::io::Input::handle_one_shot_pinch(double new_scale) {
     spdlog::get("main")->debug("[{}] at {} - {}: Scale up", FN, __LINE__,
                                __func__);
     // Add 1 to required distance to get 2 > x > 1
-    if (new_scale > 1 + config->settings.pinch_threshold) {
-      std::string command = config->get_pinch_command(gesture_pinch_event.fingers, "ONESHOT", 2);
+    if (new_scale > 1 + device_config().settings.pinch_threshold) {
+      const auto& command = device_config().get_pinch_command(gesture_pinch_event.fingers, "ONESHOT", 2);
+      record_pinch(2);
       spdlog::get("main")->debug(
           "[{}] at {} - {} - fingers: {}, type: ONESHOT, gesture: PINCH OUT ... ",
           FN, __LINE__, __func__, gesture_pinch_event.fingers);
-      if (runproc(command.c_str())) {
+      if (runproc(command, pinch_fields(2, new_scale, gesture_pinch_event.angle))) {
         gesture_pinch_event.executed = true;
       } else {
         inc_step(&gesture_pinch_event.step);
@@ -365,14 +735,15 @@ void gebaar::io::Input::handle_one_shot_pinch(double new_scale) {
     }
   } else {  // Scale Down
     spdlog::get("main")->debug("[{}] at {} - {}: Scale down {} < 1 - {}", FN, __LINE__,
-                               __func__, new_scale, config->settings.pinch_threshold);
+                               __func__, new_scale, device_config().settings.pinch_threshold);
     // Substract from 1 to have inverted value for pinch in gesture
-    if (gesture_pinch_event.scale < 1 - config->settings.pinch_threshold) {
-      std::string command = config->get_pinch_command(gesture_pinch_event.fingers, "ONESHOT", 1);
+    if (gesture_pinch_event.scale < 1 - device_config().settings.pinch_threshold) {
+      const auto& command = device_config().get_pinch_command(gesture_pinch_event.fingers, "ONESHOT", 1);
+      record_pinch(1);
       spdlog::get("main")->debug(
           "[{}] at {} - {} - fingers: {}, type: ONESHOT, gesture: PINCH IN ... ",
           FN, __LINE__, __func__, gesture_pinch_event.fingers);
-      if (runproc(command.c_str())) {
+      if (runproc(command, pinch_fields(1, new_scale, gesture_pinch_event.angle))) {
         gesture_pinch_event.executed = true;
       } else {
         dec_step(&gesture_pinch_event.step);
@@ -391,7 +762,7 @@ void gebaar::io::Input::handle_one_shot_pinch(double new_scale) {
 void gebaar::io::Input::handle_continuous_pinch(double new_scale) {
   int step = gesture_pinch_event.step == 0 ? gesture_pinch_event.step + 1
                                            : gesture_pinch_event.step;
-  double trigger = 1 + (config->settings.pinch_threshold * step);
+  double trigger = 1 + (device_config().settings.pinch_threshold * step);
   spdlog::get("main")->debug(
       "[{}] at {} - {} - scale: {} gesture_scale: {} trigger: {}",
       FN, __LINE__, __func__, new_scale, gesture_pinch_event.scale, trigger);
@@ -399,11 +770,12 @@ void gebaar::io::Input::handle_continuous_pinch(double new_scale) {
     spdlog::get("main")->debug("[{}] at {} - {}: Scale up", FN, __LINE__,
                                __func__);
     if (new_scale >= trigger) {
-      std::string command = config->get_pinch_command(gesture_pinch_event.fingers, "CONTINUOUS", 2);
+      const auto& command = device_config().get_pinch_command(gesture_pinch_event.fingers, "CONTINUOUS", 2);
+      record_pinch(2);
       spdlog::get("main")->debug(
           "[{}] at {} - {} - fingers: {}, type: CONTINUOUS, gesture: PINCH OUT ... ",
           FN, __LINE__, __func__, gesture_pinch_event.fingers);
-      if (runproc(command.c_str())) {
+      if (runproc(command, pinch_fields(2, new_scale, gesture_pinch_event.angle))) {
         inc_step(&gesture_pinch_event.step);
       } else {
         gesture_pinch_event.executed = true;
@@ -413,11 +785,12 @@ void gebaar::io::Input::handle_continuous_pinch(double new_scale) {
     spdlog::get("main")->debug("[{}] at {} - {}: Scale down", FN, __LINE__,
                                __func__);
     if (new_scale <= trigger) {
-      std::string command = config->get_pinch_command(gesture_pinch_event.fingers, "CONTINUOUS", 1);
+      const auto& command = device_config().get_pinch_command(gesture_pinch_event.fingers, "CONTINUOUS", 1);
+      record_pinch(1);
       spdlog::get("main")->debug(
           "[{}] at {} - {} - fingers: {}, type: CONTINUOUS, gesture: PINCH IN ... ",
           FN, __LINE__, __func__, gesture_pinch_event.fingers);
-      if (runproc(command.c_str())) {
+      if (runproc(command, pinch_fields(1, new_scale, gesture_pinch_event.angle))) {
         dec_step(&gesture_pinch_event.step);
       } else {
         gesture_pinch_event.executed = true;
@@ -439,12 +812,13 @@ void gebaar::io::Input::handle_one_shot_rotate(double new_angle) {
   if (new_angle > gesture_pinch_event.angle) { // Rotate right
     spdlog::get("main")->debug("[{}] at {} - {}: Rotate right", FN, __LINE__,
                                __func__);
-    if (new_angle > config->settings.rotate_threshold) {
-      std::string command = config->get_pinch_command(gesture_pinch_event.fingers, "ONESHOT", 4);
+    if (new_angle > device_config().settings.rotate_threshold) {
+      const auto& command = device_config().get_pinch_command(gesture_pinch_event.fingers, "ONESHOT", 4);
+      record_pinch(4);
       spdlog::get("main")->debug(
           "[{}] at {} - {} - fingers: {}, type: ONESHOT, gesture: ROTATE RIGHT ... ",
           FN, __LINE__, __func__, gesture_pinch_event.fingers);
-      if (runproc(command.c_str())) {
+      if (runproc(command, pinch_fields(4, gesture_pinch_event.scale, new_angle))) {
         gesture_pinch_event.executed = true;
       } else {
         inc_step(&gesture_pinch_event.step);
@@ -456,12 +830,13 @@ void gebaar::io::Input::handle_one_shot_rotate(double new_angle) {
   } else { // Rotate left
     spdlog::get("main")->debug("[{}] at {} - {}: Rotate left", FN, __LINE__,
                                __func__);
-    if (abs(new_angle) > config->settings.rotate_threshold) {
-      std::string command = config->get_pinch_command(gesture_pinch_event.fingers, "ONESHOT", 3);
+    if (std::fabs(new_angle) > device_config().settings.rotate_threshold) {
+      const auto& command = device_config().get_pinch_command(gesture_pinch_event.fingers, "ONESHOT", 3);
+      record_pinch(3);
       spdlog::get("main")->debug(
           "[{}] at {} - {} - fingers: {}, type: ONESHOT, gesture: ROTATE LEFT ... ",
           FN, __LINE__, __func__, gesture_pinch_event.fingers);
-      if (runproc(command.c_str())) {
+      if (runproc(command, pinch_fields(3, gesture_pinch_event.scale, new_angle))) {
         gesture_pinch_event.executed = true;
       } else {
         dec_step(&gesture_pinch_event.step);
@@ -481,7 +856,7 @@ void gebaar::io::Input::handle_one_shot_rotate(double new_angle) {
 void gebaar::io::Input::handle_continuous_rotate(double new_angle) {
   int step = gesture_pinch_event.step == 0 ? gesture_pinch_event.step + 1
                                            : gesture_pinch_event.step;
-  double trigger = config->settings.rotate_threshold * step;
+  double trigger = device_config().settings.rotate_threshold * step;
   spdlog::get("main")->debug(
       "[{}] at {} - {} - scale: {} gesture_scale: {} trigger: {}",
       FN, __LINE__, __func__, new_angle, gesture_pinch_event.scale, trigger);
@@ -489,11 +864,12 @@ void gebaar::io::Input::handle_continuous_rotate(double new_angle) {
     spdlog::get("main")->debug("[{}] at {} - {}: Rotate right", FN, __LINE__,
                                __func__);
     if (new_angle >= trigger) {
-      std::string command = config->get_pinch_command(gesture_pinch_event.fingers, "CONTINUOUS", 4);
+      const auto& command = device_config().get_pinch_command(gesture_pinch_event.fingers, "CONTINUOUS", 4);
+      record_pinch(4);
       spdlog::get("main")->debug(
          "[{}] at {} - {} - fingers: {}, type: CONTINUOUS, gesture: ROTATE RIGHT ... ",
          FN, __LINE__, __func__, gesture_pinch_event.fingers);
-      if (runproc(command.c_str())) {
+      if (runproc(command, pinch_fields(4, gesture_pinch_event.scale, new_angle))) {
         inc_step(&gesture_pinch_event.step);
       } else {
         gesture_pinch_event.executed = true;
@@ -503,11 +879,12 @@ void gebaar::io::Input::handle_continuous_rotate(double new_angle) {
     spdlog::get("main")->debug("[{}] at {} - {}: Rotate left", FN, __LINE__,
                                __func__);
     if (new_angle <= trigger) {
-      std::string command = config->get_pinch_command(gesture_pinch_event.fingers, "CONTINUOUS", 3);
+      const auto& command = device_config().get_pinch_command(gesture_pinch_event.fingers, "CONTINUOUS", 3);
+      record_pinch(3);
       spdlog::get("main")->debug(
         "[{}] at {} - {} - fingers: {}, type: CONTINUOUS, gesture: ROTATE LEFT ... ",
         FN, __LINE__, __func__, gesture_pinch_event.fingers);
-      if (runproc(command.c_str())) {
+      if (runproc(command, pinch_fields(3, gesture_pinch_event.scale, new_angle))) {
         dec_step(&gesture_pinch_event.step);
       } else {
         gesture_pinch_event.executed = true;
@@ -520,22 +897,31 @@ void gebaar::io::Input::handle_continuous_rotate(double new_angle) {
  * Pinch Gesture
  * Supports "one shot" or "continuous" pinch-in, pinch-out, rotate-left, and
  * rotate-right gestures.
- * @param gev Gesture Event
+ * @param ev Gesture Event
  * @param begin Boolean to denote begin or continuation of gesture.
  **/
-void gebaar::io::Input::handle_pinch_event(libinput_event_gesture* gev,
-                                           bool begin) {
+void gebaar::io::Input::handle_pinch_event(const raw_event& ev, bool begin) {
   if (begin) {
     reset_pinch_event();
-    gesture_pinch_event.fingers = libinput_event_gesture_get_finger_count(gev);
+    gesture_pinch_event.fingers = ev.fingers;
+    gesture_pinch_event.start_time = ev.time;
   } else {
     if (!gesture_pinch_event.executed) {
-      double new_scale = libinput_event_gesture_get_scale(gev);
-      double angle_delta = libinput_event_gesture_get_angle_delta(gev);
+      double new_scale = ev.scale;
+      double angle_delta = ev.angle;
       double new_angle = gesture_pinch_event.angle + angle_delta;
-      if (!gesture_pinch_event.continuous) {
-        handle_one_shot_pinch(new_scale);
-        handle_one_shot_rotate(new_angle);
+      if (gesture_pinch_event.intent == INTENT_UNDECIDED) {
+        classify_pinch_intent(new_scale, new_angle);
+      }
+      if (gesture_pinch_event.intent == INTENT_UNDECIDED) {
+        // Nothing runs until the gesture shows what it is
+      } else if (!gesture_pinch_event.continuous) {
+        if (gesture_pinch_event.intent != INTENT_ROTATE) {
+          handle_one_shot_pinch(new_scale);
+        }
+        if (gesture_pinch_event.intent != INTENT_PINCH) {
+          handle_one_shot_rotate(new_angle);
+        }
       } else {
         if (!gesture_pinch_event.rotating) {
           handle_continuous_pinch(new_scale);
@@ -554,18 +940,33 @@ void gebaar::io::Input::handle_pinch_event(libinput_event_gesture* gev,
  * signal. If it begins, we get the amount of fingers used. If it ends, we check
  * what kind of gesture we received.
  *
- * @param gev Gesture Event
+ * @param ev Gesture Event
  * @param begin Boolean to denote begin or end of gesture
  */
-void gebaar::io::Input::handle_swipe_event_without_coords(
-    libinput_event_gesture* gev, bool begin) {
+void gebaar::io::Input::handle_swipe_event_without_coords(const raw_event& ev,
+                                                          bool begin) {
   if (begin) {
-    gesture_swipe_event.fingers = libinput_event_gesture_get_finger_count(gev);
+    momentum.stop();
+    if (start_drag(ev)) {
+      return;
+    }
+    gesture_swipe_event.fingers = ev.fingers;
+    gesture_swipe_event.start_time = ev.time;
+  } else if (drag_event.active) {
+    stop_drag();
   } else {
     // This executed when fingers left the touchpad
-    if (!gesture_swipe_event.executed &&
-        config->settings.gesture_swipe_trigger_on_release) {
-      trigger_swipe_command();
+    if (!gesture_swipe_event.executed) {
+      if (device_config().settings.gesture_swipe_trigger_on_release) {
+        trigger_swipe_command();
+      } else {
+        adaptive.near_miss(
+            devices[ev.device].get(), gesture_swipe_event.fingers,
+            get_swipe_type(gesture_swipe_event.x, gesture_swipe_event.y),
+            gesture_swipe_ratio(*devices[ev.device]), ev.time);
+      }
+    } else if (start_momentum(ev)) {
+      return;  // the swipe goes on until its momentum runs out
     }
     reset_swipe_event();
   }
@@ -573,28 +974,209 @@ void gebaar::io::Input::handle_swipe_event_without_coords(
 
 /**
  * Swipe events with coordinates, add it to the current tally
- * @param gev Gesture Event
+ * @param ev Gesture Event
  */
-void gebaar::io::Input::handle_swipe_event_with_coords(
-    libinput_event_gesture* gev) {
-  if (config->settings.gesture_swipe_one_shot && gesture_swipe_event.executed)
+void gebaar::io::Input::handle_swipe_event_with_coords(const raw_event& ev) {
+  if (drag_event.active) {
+    move_drag(ev);
+    return;
+  }
+  if (device_config().settings.gesture_swipe_one_shot && gesture_swipe_event.executed)
     return;
 
-  // Since swipe gesture counts in dpi we have to convert
-  int threshold_x = config->settings.gesture_swipe_threshold *
-                    SWIPE_X_THRESHOLD * gesture_swipe_event.step;
-  int threshold_y = config->settings.gesture_swipe_threshold *
-                    SWIPE_Y_THRESHOLD * gesture_swipe_event.step;
-  gesture_swipe_event.x += libinput_event_gesture_get_dx_unaccelerated(gev);
-  gesture_swipe_event.y += libinput_event_gesture_get_dy_unaccelerated(gev);
-  if (abs(gesture_swipe_event.x) > threshold_x ||
-      abs(gesture_swipe_event.y) > threshold_y) {
+  if (device_config().settings.swipe_momentum) {
+    momentum.track(ev.x, ev.y, ev.time);
+  }
+  advance_swipe(ev);
+}
+
+/**
+ * Add a delta to the swipe and run the next step once it covers the
+ * threshold. Updates and momentum ticks both step through here.
+ *
+ * @param ev swipe update or momentum tick, with its delta
+ */
+void gebaar::io::Input::advance_swipe(const raw_event& ev) {
+  gesture_swipe_event.x += ev.x;
+  gesture_swipe_event.y += ev.y;
+  double ratio = gesture_swipe_ratio(*devices[ev.device]);
+  // The threshold is covered once before the first step, not right away
+  int step = gesture_swipe_event.step == 0 ? gesture_swipe_event.step + 1
+                                           : gesture_swipe_event.step;
+  if (ratio > step) {
+    size_t swipe_type =
+        get_swipe_type(gesture_swipe_event.x, gesture_swipe_event.y);
+    record_decision(TRACE_THRESHOLD, TRACE_SWIPE, swipe_type,
+                    gesture_swipe_event.fingers);
+    if (!gesture_swipe_event.executed) {
+      adaptive.success(devices[ev.device].get(), gesture_swipe_event.fingers,
+                       swipe_type, ratio,
+                       ev.time - gesture_swipe_event.start_time, ev.time);
+      schedule_adaptive_save();
+    }
     trigger_swipe_command();
     gesture_swipe_event.executed = true;
     inc_step(&gesture_swipe_event.step);
   }
 }
 
+/**
+ * Keep a continuous swipe going after the fingers lift, if they were still
+ * moving fast enough
+ *
+ * @param ev swipe end
+ * @return bool true if momentum took over the swipe
+ */
+bool gebaar::io::Input::start_momentum(const raw_event& ev) {
+  const auto& settings = device_config().settings;
+  if (!settings.swipe_momentum || settings.gesture_swipe_one_shot ||
+      !momentum.start(ev.time, settings.swipe_momentum_decay_ms)) {
+    return false;
+  }
+  const device_state& device = *devices[ev.device];
+  double rate =
+      momentum.rate(device.swipe_threshold_x * threshold_scale(device),
+                    device.swipe_threshold_y * threshold_scale(device));
+  if (rate < settings.swipe_momentum_min_rate) {
+    momentum.stop();
+    return false;
+  }
+  spdlog::get("main")->debug("[{}] at {} - {}: momentum at {} steps/s", FN,
+                             __LINE__, __func__, rate);
+  momentum_device = ev.device;
+  if (attached_loop != nullptr) {
+    momentum_timer.arm(MOMENTUM_TICK_MS, MOMENTUM_TICK_MS);
+  }
+  return true;
+}
+
+/**
+ * Move the swipe by the distance its momentum covered since the last tick,
+ * stopping once it is slower than settings.swipe.momentum_min_rate
+ *
+ * @param ev momentum tick
+ */
+void gebaar::io::Input::handle_momentum_tick(const raw_event& ev) {
+  if (!momentum.active()) {
+    return;
+  }
+  raw_event step = ev;
+  momentum.advance(ev.time, &step.x, &step.y);
+  advance_swipe(step);
+  const device_state& device = *devices[ev.device];
+  if (momentum.rate(device.swipe_threshold_x * threshold_scale(device),
+                    device.swipe_threshold_y * threshold_scale(device)) <
+      device_config().settings.swipe_momentum_min_rate) {
+    stop_momentum();
+  }
+}
+
+/**
+ * End the momentum of a swipe, and with it the swipe
+ */
+void gebaar::io::Input::stop_momentum() {
+  momentum.stop();
+  momentum_timer.disarm();
+  reset_swipe_event();
+}
+
+/**
+ * Step the swipe momentum carries on. The tick is recorded like an input
+ * event, so replays step at the same times.
+ */
+void gebaar::io::Input::momentum_timer_expired() {
+  momentum_timer.expirations();
+  if (!momentum.active()) {
+    return;
+  }
+  struct timespec now {};
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  raw_event ev{};
+  ev.time = now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+  ev.type = TRACE_MOMENTUM;
+  ev.device = momentum_device;
+  ev.fingers = gesture_swipe_event.fingers;
+  recorder.record(ev);
+  process_event(ev);
+}
+
+/**
+ * Take a touchpad swipe over as a drag if it has the configured finger
+ * count: the button goes down and the swipe's commands don't run
+ *
+ * @param ev swipe begin
+ * @return bool true if the swipe drags
+ */
+bool gebaar::io::Input::start_drag(const raw_event& ev) {
+  const auto& settings = device_config().settings;
+  if (settings.swipe_drag_fingers <= 0 ||
+      ev.fingers != settings.swipe_drag_fingers ||
+      (pointer != nullptr && !pointer->open())) {
+    return false;
+  }
+  drag_event = {true, static_cast<size_t>(ev.fingers), 0, 0, 0, 0};
+  if (pointer != nullptr) {
+    pointer->button(true);
+  }
+  return true;
+}
+
+/**
+ * Forward a swipe update to the pointer, one write and no allocation
+ *
+ * @param ev swipe update, its unaccelerated delta
+ */
+void gebaar::io::Input::move_drag(const raw_event& ev) {
+  double speed = device_config().settings.swipe_drag_speed;
+  drag_event.x += ev.x * speed;
+  drag_event.y += ev.y * speed;
+  int dx = static_cast<int>(drag_event.x);
+  int dy = static_cast<int>(drag_event.y);
+  drag_event.x -= dx;
+  drag_event.y -= dy;
+  drag_event.moved_x += dx;
+  drag_event.moved_y += dy;
+  if ((dx != 0 || dy != 0) && pointer != nullptr) {
+    pointer->move(dx, dy);
+  }
+}
+
+void gebaar::io::Input::stop_drag() {
+  if (pointer != nullptr) {
+    pointer->button(false);
+  }
+  spdlog::get("main")->debug(
+      "[{}] at {} - {} - fingers: {}, type: GESTURE, gesture: DRAG", FN,
+      __LINE__, __func__, drag_event.fingers);
+  record_decision(TRACE_GESTURE, TRACE_DRAG, 0, drag_event.fingers,
+                  drag_event.moved_x, drag_event.moved_y);
+  drag_event = {};
+}
+
+/**
+ * Distance covered by the current touchpad swipe relative to the device's
+ * threshold, on whichever axis is closer to it
+ *
+ * @param device device the swipe is performed on
+ */
+double gebaar::io::Input::gesture_swipe_ratio(const device_state& device) {
+  // Converted to gesture delta units when the device was added
+  double threshold_x = device.swipe_threshold_x * threshold_scale(device);
+  double threshold_y = device.swipe_threshold_y * threshold_scale(device);
+  return std::max(std::fabs(gesture_swipe_event.x) / threshold_x,
+                  std::fabs(gesture_swipe_event.y) / threshold_y);
+}
+
+/**
+ * Have the adaptive history written a little later from the event loop, if
+ * it changed. Replays are not attached and never write it.
+ */
+void gebaar::io::Input::schedule_adaptive_save() {
+  if (attached_loop != nullptr && adaptive.schedule_save()) {
+    adaptive_timer.arm(ADAPTIVE_SAVE_DELAY_MS);
+  }
+}
+
 /**
  * Making calculation for swipe direction and triggering
  * command accordingly
@@ -603,23 +1185,36 @@ void gebaar::io::Input::trigger_swipe_command() {
   double x = gesture_swipe_event.x;
   double y = gesture_swipe_event.y;
   int swipe_type = get_swipe_type(x, y);
-  apply_swipe(swipe_type, gesture_swipe_event.fingers, swipe_event_group);
+  gebaar::config::gesture_fields fields;
+  fields.step = ++gesture_swipe_event.triggered;
+  fields.dx = x;
+  fields.dy = y;
+  fields.duration_ms = (current_time - gesture_swipe_event.start_time) / 1000;
+  apply_swipe(swipe_type, gesture_swipe_event.fingers, swipe_event_group,
+              fields);
   spdlog::get("main")->debug("[{}] at {} - {}: swipe type {}", FN, __LINE__,
                              __func__, config->get_swipe_type_name(swipe_type));
+  // Continuous swipes keep going with the same fingers
+  int fingers = gesture_swipe_event.fingers;
+  int triggered = gesture_swipe_event.triggered;
+  uint64_t start_time = gesture_swipe_event.start_time;
   gesture_swipe_event = {};
+  gesture_swipe_event.fingers = fingers;
+  gesture_swipe_event.triggered = triggered;
+  gesture_swipe_event.start_time = start_time;
 }
 
 /**
  * Handles switch events.
  *
- * @param gev Switch Event
+ * @param ev Switch Event
  * 0 == laptop
  * 1 == tablet
  */
-void gebaar::io::Input::handle_switch_event(libinput_event_switch* gev)
+void gebaar::io::Input::handle_switch_event(const raw_event& ev)
 {
-  int state = libinput_event_switch_get_switch_state(gev);
-  int state_2 = libinput_event_switch_get_switch(gev);
+  int state = ev.value;
+  int state_2 = ev.code;
   spdlog::get("main")->debug("[{}] at {} - state: {}, state_2: {}", FN, __LINE__, state, state_2);
   if (state_2 == 2) {
     if (state == 0) {
@@ -629,37 +1224,233 @@ void gebaar::io::Input::handle_switch_event(libinput_event_switch* gev)
       spdlog::get("main")->debug("[{}] at {} - Tablet Switch", FN, __LINE__);
       swipe_event_group = "TOUCH";
     }
-    std::string command = config->get_switch_command(state);
-    runproc(command.c_str());
+    const auto& command = device_config().get_switch_command(state);
+    record_decision(TRACE_GESTURE, TRACE_SWITCH, state);
+    gebaar::config::gesture_fields fields;
+    fields.direction = &SWITCH_COMMANDS.at(state);
+    runproc(command, fields);
+  }
+}
+
+/**
+ * libinput hold gesture, fingers resting on a touchpad. libinput ends it,
+ * cancelled, as soon as they start a swipe or pinch.
+ *
+ * @param ev Gesture Event
+ * @param begin Boolean to denote begin or end of the hold
+ */
+void gebaar::io::Input::handle_hold_event(const raw_event& ev, bool begin) {
+  if (begin) {
+    if (momentum.active()) {
+      stop_momentum();
+    }
+    start_hold(ev, ev.fingers, false);
+  } else if (!hold_event.touch) {
+    stop_hold();
+  }
+}
+
+/**
+ * Wait for fingers to rest for settings.hold.delay_ms, if a hold command is
+ * bound for them
+ *
+ * @param ev event the fingers came to rest with
+ * @param fingers fingers resting
+ * @param touch true on a touchscreen
+ */
+void gebaar::io::Input::start_hold(const raw_event& ev, size_t fingers,
+                                   bool touch) {
+  stop_hold();
+  if (device_config()
+          .get_hold_command(fingers, touch ? HOLD_TOUCH : HOLD_GESTURE)
+          .empty()) {
+    return;
+  }
+  hold_event = {};
+  hold_event.active = true;
+  hold_event.touch = touch;
+  hold_event.fingers = fingers;
+  hold_event.device = ev.device;
+  hold_event.start_time = ev.time;
+  if (attached_loop != nullptr) {
+    hold_timer.arm(device_config().settings.hold_delay_ms);
+  }
+}
+
+/**
+ * The fingers moved or lifted, no more hold commands
+ */
+void gebaar::io::Input::stop_hold() {
+  if (hold_event.active) {
+    hold_event.active = false;
+    hold_timer.disarm();
+  }
+}
+
+/**
+ * Run the hold command, then keep repeating it at
+ * settings.hold.repeat_rate. A repeat is dropped by the supervisor while
+ * the previous one still runs, so a slow command can't pile up.
+ *
+ * @param ev hold timer tick
+ */
+void gebaar::io::Input::handle_hold_tick(const raw_event& ev) {
+  if (!hold_event.active) {
+    return;
+  }
+  const auto& command = device_config().get_hold_command(
+      hold_event.fingers, hold_event.touch ? HOLD_TOUCH : HOLD_GESTURE);
+  if (hold_event.step == 0) {  // rested for settings.hold.delay_ms
+    record_decision(TRACE_THRESHOLD, TRACE_HOLD, 1, hold_event.fingers);
+  }
+  record_decision(TRACE_GESTURE, TRACE_HOLD, 1, hold_event.fingers);
+  gebaar::config::gesture_fields fields;
+  fields.fingers = hold_event.fingers;
+  fields.direction = &HOLD_COMMANDS.at(1);
+  fields.step = ++hold_event.step;
+  fields.duration_ms = (ev.time - hold_event.start_time) / 1000;
+  runproc(command, fields);
+  if (hold_event.touch) {
+    touch_swipe_event.held = true;
+  }
+
+  const auto& settings = device_config().settings;
+  if (settings.hold_repeat_rate <= 0) {
+    stop_hold();
+  } else if (hold_event.step == 1 && attached_loop != nullptr) {
+    hold_timer.arm(settings.hold_repeat_delay_ms,
+                   std::max(1.0, 1000 / settings.hold_repeat_rate));
+  }
+}
+
+/**
+ * Run or repeat the hold command. The tick is recorded like an input event,
+ * so replays run it at the same times.
+ */
+void gebaar::io::Input::hold_timer_expired() {
+  hold_timer.expirations();
+  if (!hold_event.active) {
+    return;
   }
+  struct timespec now {};
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  raw_event ev{};
+  ev.time = now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+  ev.type = TRACE_HOLD_TICK;
+  ev.device = hold_event.device;
+  ev.fingers = hold_event.fingers;
+  recorder.record(ev);
+  process_event(ev);
 }
 
 
 
 /**
- * Initialize the input system
+ * Initialize the input system. State kept from earlier runs is only loaded
+ * here, replays start from the configuration alone.
  * @return bool
  */
 bool gebaar::io::Input::initialize() {
+  std::string state_dir = gebaar::util::xdg_state_dir();
+  if (!state_dir.empty() && seat != "seat0") {
+    state_dir += "/" + seat;
+    std::error_code error;
+    std::filesystem::create_directories(state_dir, error);
+  }
+  calibration.load(state_dir.empty() ? "" : state_dir + "/calibration.toml");
+  adaptive.load(state_dir.empty() ? "" : state_dir + "/adaptive.bin", *config);
+  pointer = std::make_unique<UinputPointer>();
+  if (!state_dir.empty() && usage.open(state_dir + "/stats.bin", true) &&
+      supervisor != nullptr) {
+    supervisor->record_usage(&usage);
+  }
   initialize_context();
   return gesture_device_exists();
 }
 
 /**
- * Run a poll loop on the file descriptor that libinput gives us
+ * Register the file descriptor that libinput gives us with the event loop
+ *
+ * @param loop event loop to dispatch libinput events from
  */
-void gebaar::io::Input::start_loop() {
-  struct pollfd fds {};
-  fds.fd = libinput_get_fd(libinput);
-  fds.events = POLLIN;
-  fds.revents = 0;
+void gebaar::io::Input::attach(EventLoop& loop) {
+  attached_loop = &loop;
+  loop.watch(libinput_get_fd(libinput), [this] { handle_event(); });
+  loop.watch(momentum_timer.fd(), [this] { momentum_timer_expired(); });
+  loop.watch(hold_timer.fd(), [this] { hold_timer_expired(); });
+  loop.watch(adaptive_timer.fd(), [this] {
+    adaptive_timer.expirations();
+    adaptive.save();
+  });
 
-  while (poll(&fds, 1, -1) > -1) {
-    handle_event();
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGUSR1);
+  sigprocmask(SIG_BLOCK, &mask, nullptr);
+  dump_signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+  loop.watch(dump_signal_fd, [this] {
+    struct signalfd_siginfo info {};
+    while (read(dump_signal_fd, &info, sizeof(info)) == sizeof(info)) {
+    }
+    for (auto* input : attached_inputs) {
+      input->dump_trace();
+    }
+  });
+  attached_inputs.push_back(this);
+}
+
+/**
+ * One line summary of what was handled so far, for the service manager
+ */
+std::string gebaar::io::Input::status() const {
+  uint64_t runs = 0;
+  uint64_t dropped = 0;
+  // Replays have no supervisor
+  if (supervisor != nullptr) {
+    for (const auto& binding : supervisor->stats()) {
+      runs += binding.second.runs;
+      dropped += binding.second.dropped;
+    }
   }
+  size_t attached = std::count_if(
+      devices.begin(), devices.end(),
+      [](const std::unique_ptr<device_state>& state) {
+        return state->device != nullptr;
+      });
+  return std::to_string(attached) + " devices, " + std::to_string(gestures) +
+         " gestures, " + std::to_string(runs) + " commands run, " +
+         std::to_string(dropped) + " dropped, " +
+         std::to_string(lag.slow_events) + " slow events (up to " +
+         std::to_string(lag.slow_max_usec / 1000) + " ms), libinput behind " +
+         std::to_string(lag.libinput_reports) + " times for " +
+         std::to_string(lag.libinput_total_ms) + " ms, " +
+         std::to_string(lag.client_bugs) + " client bugs";
 }
 
-gebaar::io::Input::~Input() { libinput_unref(libinput); }
+gebaar::io::Input::~Input() {
+  adaptive.save();  // a change still waiting for its timer
+  if (supervisor != nullptr) {
+    supervisor->record_usage(nullptr);
+  }
+  if (attached_loop != nullptr) {
+    attached_inputs.erase(
+        std::find(attached_inputs.begin(), attached_inputs.end(), this));
+    attached_loop->unwatch(libinput_get_fd(libinput));
+    attached_loop->unwatch(momentum_timer.fd());
+    attached_loop->unwatch(hold_timer.fd());
+    attached_loop->unwatch(adaptive_timer.fd());
+    attached_loop->unwatch(dump_signal_fd);
+  }
+  if (dump_signal_fd >= 0) {
+    close(dump_signal_fd);
+  }
+  if (libinput != nullptr) {
+    libinput_unref(libinput);
+  }
+  if (udev != nullptr) {
+    udev_unref(udev);
+  }
+}
 
 /**
  * Check if there's a device that supports gestures on this system
@@ -676,6 +1467,10 @@ bool gebaar::io::Input::gesture_device_exists() {
   } else {
     while ((libinput_event = libinput_get_event(libinput)) != nullptr) {
       auto device = libinput_event_get_device(libinput_event);
+      raw_event ev{};
+      if (read_event(libinput_event, &ev)) {
+        recorder.record(ev);
+      }
       spdlog::get("main")->debug(
           "[{}] at {} - {}: Testing capabilities for device {}", FN, __LINE__,
           __func__, libinput_device_get_name(device));
@@ -708,7 +1503,7 @@ bool gebaar::io::Input::gesture_device_exists() {
   return !swipe_event_group.empty();
 }
 
-bool gebaar::io::Input::check_chosen_event(std::string ev) {
+bool gebaar::io::Input::check_chosen_event(const char* ev) {
   if (strcmp(config->settings.interact_type.c_str(), "BOTH") == 0 ) {
     swipe_event_group = ev;
     return true;
@@ -725,100 +1520,456 @@ bool gebaar::io::Input::check_chosen_event(std::string ev) {
 void gebaar::io::Input::handle_event() {
   libinput_dispatch(libinput);
   while ((libinput_event = libinput_get_event(libinput))) {
-    switch (libinput_event_get_type(libinput_event)) {
-      case LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN:
-        if (check_chosen_event("GESTURE")) {
-          handle_swipe_event_without_coords(
-              libinput_event_get_gesture_event(libinput_event), true);
-        }
-        break;
-      case LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE:
-        if (check_chosen_event("GESTURE")) {
-          handle_swipe_event_with_coords(
-              libinput_event_get_gesture_event(libinput_event));
-        }
-        break;
-      case LIBINPUT_EVENT_GESTURE_SWIPE_END:
-        if (check_chosen_event("GESTURE")) {
-          handle_swipe_event_without_coords(
-              libinput_event_get_gesture_event(libinput_event), false);
-        }
-        break;
-      case LIBINPUT_EVENT_GESTURE_PINCH_BEGIN:
-        handle_pinch_event(libinput_event_get_gesture_event(libinput_event),
-                           true);
-        break;
-      case LIBINPUT_EVENT_GESTURE_PINCH_UPDATE:
-        handle_pinch_event(libinput_event_get_gesture_event(libinput_event),
-                           false);
-        break;
-      case LIBINPUT_EVENT_GESTURE_PINCH_END:
-        break;
-      /*
-      case LIBINPUT_EVENT_NONE:
-        break;
-      case LIBINPUT_EVENT_DEVICE_ADDED:
-        break;
-      case LIBINPUT_EVENT_DEVICE_REMOVED:
-        break;
-      case LIBINPUT_EVENT_KEYBOARD_KEY:
-        break;
-      case LIBINPUT_EVENT_POINTER_MOTION:
-        break;
-      case LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE:
-        break;
-      case LIBINPUT_EVENT_POINTER_BUTTON:
-        break;
-      case LIBINPUT_EVENT_POINTER_AXIS:
-        break;
-      */
-      case LIBINPUT_EVENT_TOUCH_DOWN:
-        if (check_chosen_event("TOUCH")) {
-          handle_touch_event_down(
-              libinput_event_get_touch_event(libinput_event));
-        }
-        break;
-      case LIBINPUT_EVENT_TOUCH_UP:
-        if (check_chosen_event("TOUCH")) {
-          handle_touch_event_up(libinput_event_get_touch_event(libinput_event));
-        }
-        break;
-      case LIBINPUT_EVENT_TOUCH_MOTION:
-        if (check_chosen_event("TOUCH")) {
-          handle_touch_event_motion(
-              libinput_event_get_touch_event(libinput_event));
-        }
-        break;
-      /*
-      case LIBINPUT_EVENT_TOUCH_CANCEL:
-        break;
-      case LIBINPUT_EVENT_TOUCH_FRAME:
-        break;
-      case LIBINPUT_EVENT_TABLET_TOOL_AXIS:
-        break;
-      case LIBINPUT_EVENT_TABLET_TOOL_PROXIMITY:
-        break;
-      case LIBINPUT_EVENT_TABLET_TOOL_TIP:
-        break;
-      case LIBINPUT_EVENT_TABLET_TOOL_BUTTON:
-        break;
-      case LIBINPUT_EVENT_TABLET_PAD_BUTTON:
-        break;
-      case LIBINPUT_EVENT_TABLET_PAD_RING:
-        break;
-      case LIBINPUT_EVENT_TABLET_PAD_STRIP:
-        break;
-      case LIBINPUT_EVENT_TABLET_PAD_KEY:
-        break;
-      */
-      case LIBINPUT_EVENT_SWITCH_TOGGLE:
-        handle_switch_event(libinput_event_get_switch_event(libinput_event));
+    raw_event ev{};
+    if (read_event(libinput_event, &ev)) {
+      GEBAAR_PROBE4(event, ev.time, ev.type, ev.device, ev.slot);
+      recorder.record(ev);
+      event_command = nullptr;
+      struct timespec start {};
+      clock_gettime(CLOCK_MONOTONIC, &start);
+#ifdef GEBAAR_ALLOC_AUDIT
+      // Once a gesture went through, what first use sets up is in place
+      bool warm = gestures > 0;
+      uint64_t allocations = gebaar::util::thread_allocations();
+      process_event(ev);
+      allocations = gebaar::util::thread_allocations() - allocations;
+      if (warm && allocations > 0) {
+        spdlog::get("main")->warn(
+            "[{}] at {} - {} allocations processing event type {}", FN,
+            __LINE__, allocations, ev.type);
+      }
+#else
+      process_event(ev);
+#endif
+      struct timespec end {};
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      watchdog(ev, (end.tv_sec - start.tv_sec) * 1000000 +
+                       (end.tv_nsec - start.tv_nsec) / 1000);
+    } else if (momentum.active() &&
+               libinput_event_get_type(libinput_event) >=
+                   LIBINPUT_EVENT_POINTER_MOTION &&
+               libinput_event_get_type(libinput_event) <
+                   LIBINPUT_EVENT_TOUCH_DOWN) {
+      // A finger back on the touchpad moves the pointer or scrolls before
+      // it makes a gesture
+      stop_momentum();
+    }
+    libinput_event_destroy(libinput_event);
+    libinput_dispatch(libinput);
+  }
+}
+
+/**
+ * Name of the handler an event type is dispatched to, for log messages
+ */
+static const char* handler_name(uint32_t type) {
+  switch (type) {
+    case LIBINPUT_EVENT_DEVICE_ADDED:
+    case LIBINPUT_EVENT_DEVICE_REMOVED:
+      return "device";
+    case LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN:
+    case LIBINPUT_EVENT_GESTURE_SWIPE_END:
+      return "handle_swipe_event_without_coords";
+    case LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE:
+      return "handle_swipe_event_with_coords";
+    case LIBINPUT_EVENT_GESTURE_PINCH_BEGIN:
+    case LIBINPUT_EVENT_GESTURE_PINCH_UPDATE:
+    case LIBINPUT_EVENT_GESTURE_PINCH_END:
+      return "handle_pinch_event";
+    case LIBINPUT_EVENT_TOUCH_DOWN:
+      return "handle_touch_event_down";
+    case LIBINPUT_EVENT_TOUCH_UP:
+      return "handle_touch_event_up";
+    case LIBINPUT_EVENT_TOUCH_MOTION:
+      return "handle_touch_event_motion";
+    case LIBINPUT_EVENT_TOUCH_FRAME:
+      return "handle_touch_event_frame";
+    case LIBINPUT_EVENT_TOUCH_CANCEL:
+      return "handle_touch_event_cancel";
+    case LIBINPUT_EVENT_SWITCH_TOGGLE:
+      return "handle_switch_event";
+#ifdef GEBAAR_HOLD_GESTURES
+    case LIBINPUT_EVENT_GESTURE_HOLD_BEGIN:
+    case LIBINPUT_EVENT_GESTURE_HOLD_END:
+      return "handle_hold_event";
+#endif
+    default:
+      return "unknown";
+  }
+}
+
+/**
+ * Flag an event that kept the loop busy for longer than
+ * settings.watchdog.budget_ms, naming its handler and the command it ran
+ *
+ * @param ev event that was processed
+ * @param elapsed_usec time its handler took
+ */
+void gebaar::io::Input::watchdog(const raw_event& ev, uint64_t elapsed_usec) {
+  double budget_ms = config->settings.watchdog_budget_ms;
+  if (budget_ms <= 0 || elapsed_usec <= budget_ms * 1000) {
+    return;
+  }
+  ++lag.slow_events;
+  lag.slow_max_usec = std::max(lag.slow_max_usec, elapsed_usec);
+  record_decision(TRACE_LAG, LAG_HANDLER,
+                  static_cast<int32_t>(std::min<uint64_t>(elapsed_usec,
+                                                          INT32_MAX)));
+  spdlog::get("main")->warn(
+      "{} for {} took {} ms{}{} ({} slow events, libinput fell behind {} "
+      "times by up to {} ms)",
+      handler_name(ev.type), devices[ev.device]->info.name, elapsed_usec / 1000,
+      event_command != nullptr ? " running " : "",
+      event_command != nullptr ? *event_command : "", lag.slow_events,
+      lag.libinput_reports, lag.libinput_max_ms);
+}
+
+/**
+ * Copy what the recognizers need out of a libinput event. Keyboard and
+ * pointer events are skipped, they are never recorded.
+ *
+ * @param event libinput event
+ * @param ev receives the event
+ * @return bool false if the event is of no interest
+ */
+bool gebaar::io::Input::read_event(struct libinput_event* event,
+                                   raw_event* ev) {
+  ev->type = libinput_event_get_type(event);
+  libinput_device* device = libinput_event_get_device(event);
+  switch (ev->type) {
+    case LIBINPUT_EVENT_DEVICE_ADDED:
+    case LIBINPUT_EVENT_DEVICE_REMOVED: {
+      struct timespec now {};
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      ev->time = now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+      ev->device = register_device(device)->id;
+      if (ev->type == LIBINPUT_EVENT_DEVICE_REMOVED) {
+        unregister_device(device);
+      }
+      return true;
+    }
+    case LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN:
+    case LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE:
+    case LIBINPUT_EVENT_GESTURE_SWIPE_END:
+    case LIBINPUT_EVENT_GESTURE_PINCH_BEGIN:
+    case LIBINPUT_EVENT_GESTURE_PINCH_UPDATE:
+    case LIBINPUT_EVENT_GESTURE_PINCH_END:
+#ifdef GEBAAR_HOLD_GESTURES
+    case LIBINPUT_EVENT_GESTURE_HOLD_BEGIN:
+    case LIBINPUT_EVENT_GESTURE_HOLD_END:
+#endif
+    {
+      auto gev = libinput_event_get_gesture_event(event);
+      ev->time = libinput_event_gesture_get_time_usec(gev);
+      ev->fingers = libinput_event_gesture_get_finger_count(gev);
+      if (ev->type == LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE ||
+          ev->type == LIBINPUT_EVENT_GESTURE_PINCH_UPDATE) {
+        ev->x = libinput_event_gesture_get_dx_unaccelerated(gev);
+        ev->y = libinput_event_gesture_get_dy_unaccelerated(gev);
+      }
+      if (ev->type == LIBINPUT_EVENT_GESTURE_PINCH_UPDATE) {
+        ev->scale = libinput_event_gesture_get_scale(gev);
+        ev->angle = libinput_event_gesture_get_angle_delta(gev);
+      }
+      break;
+    }
+    case LIBINPUT_EVENT_TOUCH_DOWN:
+    case LIBINPUT_EVENT_TOUCH_UP:
+    case LIBINPUT_EVENT_TOUCH_MOTION:
+    case LIBINPUT_EVENT_TOUCH_CANCEL:
+    case LIBINPUT_EVENT_TOUCH_FRAME: {
+      auto tev = libinput_event_get_touch_event(event);
+      ev->time = libinput_event_touch_get_time_usec(tev);
+      if (ev->type == LIBINPUT_EVENT_TOUCH_FRAME) {
         break;
-      default:
+      }
+      ev->slot = libinput_event_touch_get_slot(tev);
+      if (ev->type == LIBINPUT_EVENT_TOUCH_CANCEL) {
         break;
+      }
+      if (ev->type != LIBINPUT_EVENT_TOUCH_UP) {
+        ev->x = libinput_event_touch_get_x(tev);
+        ev->y = libinput_event_touch_get_y(tev);
+      }
+      break;
+    }
+    case LIBINPUT_EVENT_SWITCH_TOGGLE: {
+      auto sev = libinput_event_get_switch_event(event);
+      ev->time = libinput_event_switch_get_time_usec(sev);
+      ev->code = libinput_event_switch_get_switch(sev);
+      ev->value = libinput_event_switch_get_switch_state(sev);
+      break;
     }
+    default:
+      return false;
+  }
+  ev->device = register_device(device)->id;
+  return true;
+}
 
-    libinput_event_destroy(libinput_event);
-    libinput_dispatch(libinput);
+/**
+ * Run the appropriate action per event type
+ *
+ * @param ev event read from libinput
+ */
+void gebaar::io::Input::process_event(const raw_event& ev) {
+  current_time = ev.time;
+  current_device = devices[ev.device].get();
+  if (momentum.active() && (ev.type == LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN ||
+                            ev.type == LIBINPUT_EVENT_GESTURE_PINCH_BEGIN ||
+                            ev.type == LIBINPUT_EVENT_TOUCH_DOWN)) {
+    stop_momentum();
+  }
+  if (ev.type == LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN ||
+      ev.type == LIBINPUT_EVENT_GESTURE_PINCH_BEGIN ||
+      (ev.type == LIBINPUT_EVENT_TOUCH_DOWN &&
+       touch_swipe_event.down_slots.empty())) {
+    gesture_start = ev.time;
+  }
+  switch (ev.type) {
+    case LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN:
+      if (check_chosen_event("GESTURE")) {
+        handle_swipe_event_without_coords(ev, true);
+      }
+      break;
+    case LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE:
+      if (check_chosen_event("GESTURE")) {
+        handle_swipe_event_with_coords(ev);
+      }
+      break;
+    case LIBINPUT_EVENT_GESTURE_SWIPE_END:
+      if (check_chosen_event("GESTURE")) {
+        handle_swipe_event_without_coords(ev, false);
+      }
+      break;
+    case LIBINPUT_EVENT_GESTURE_PINCH_BEGIN:
+      handle_pinch_event(ev, true);
+      break;
+    case LIBINPUT_EVENT_GESTURE_PINCH_UPDATE:
+      handle_pinch_event(ev, false);
+      break;
+    case LIBINPUT_EVENT_GESTURE_PINCH_END:
+      break;
+    case LIBINPUT_EVENT_TOUCH_DOWN:
+      if (check_chosen_event("TOUCH")) {
+        handle_touch_event_down(ev);
+      }
+      break;
+    case LIBINPUT_EVENT_TOUCH_UP:
+      if (check_chosen_event("TOUCH")) {
+        handle_touch_event_up(ev);
+      }
+      break;
+    case LIBINPUT_EVENT_TOUCH_MOTION:
+      if (check_chosen_event("TOUCH")) {
+        handle_touch_event_motion(ev);
+      }
+      break;
+    case LIBINPUT_EVENT_TOUCH_CANCEL:
+      if (check_chosen_event("TOUCH")) {
+        handle_touch_event_cancel();
+      }
+      break;
+    case LIBINPUT_EVENT_TOUCH_FRAME:
+      if (check_chosen_event("TOUCH")) {
+        handle_touch_event_frame(ev);
+      }
+      break;
+    case LIBINPUT_EVENT_SWITCH_TOGGLE:
+      handle_switch_event(ev);
+      break;
+#ifdef GEBAAR_HOLD_GESTURES
+    case LIBINPUT_EVENT_GESTURE_HOLD_BEGIN:
+      gesture_start = ev.time;
+      if (check_chosen_event("GESTURE")) {
+        handle_hold_event(ev, true);
+      }
+      break;
+    case LIBINPUT_EVENT_GESTURE_HOLD_END:
+      if (check_chosen_event("GESTURE")) {
+        handle_hold_event(ev, false);
+      }
+      break;
+#endif
+    case TRACE_MOMENTUM:
+      handle_momentum_tick(ev);
+      break;
+    case TRACE_HOLD_TICK:
+      handle_hold_tick(ev);
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+ * Add a device known only from a trace
+ *
+ * @param info device as it was recorded
+ * @return device_state*
+ */
+gebaar::io::device_state* gebaar::io::Input::add_device(
+    const trace_device& info) {
+  devices.push_back(std::make_unique<device_state>());
+  device_state* state = devices.back().get();
+  state->id = devices.size() - 1;
+  state->info = info;
+  state->info.name[TRACE_DEVICE_NAME - 1] = '\0';
+  configure_device(state);
+  return state;
+}
+
+/**
+ * Resolve the [[device]] section of a device that was just added, so events
+ * only follow its pointer
+ *
+ * @param state device with its info filled in
+ */
+void gebaar::io::Input::configure_device(device_state* state) {
+  uint32_t classes = 0;
+  if (state->info.capabilities & (1U << LIBINPUT_DEVICE_CAP_GESTURE)) {
+    classes |= DEVICE_TOUCHPAD;
+  }
+  if (state->info.capabilities & (1U << LIBINPUT_DEVICE_CAP_TOUCH)) {
+    classes |= DEVICE_TOUCHSCREEN;
+  }
+  if (state->info.capabilities & (1U << LIBINPUT_DEVICE_CAP_SWITCH)) {
+    classes |= DEVICE_SWITCH;
+  }
+  state->config = &config->match_device(
+      state->info.name, state->info.usb_id >> 16, state->info.usb_id & 0xffff,
+      classes);
+  const auto& settings = state->config->settings;
+  state->regions.configure(state->config->regions);
+  if (!settings.swipe_sector_widths.empty()) {
+    state->directions.configure(settings.swipe_sectors,
+                                settings.swipe_sector_widths.data());
+  } else {
+    state->directions.configure(settings.swipe_sectors,
+                                settings.swipe_axis_width > 0
+                                    ? settings.swipe_axis_width
+                                    : 360.0 / settings.swipe_sectors);
+  }
+  calibration.calibrate(state);
+  adaptive.attach(state);
+  if (pointer != nullptr && settings.swipe_drag_fingers > 0) {
+    pointer->open();  // ahead of the first drag
+  }
+}
+
+/**
+ * Look up the state kept for a device, creating it the first time the device
+ * is seen. A device that comes back after removal gets its old entry back.
+ *
+ * @param device libinput device
+ * @return device_state*
+ */
+gebaar::io::device_state* gebaar::io::Input::register_device(
+    libinput_device* device) {
+  auto state =
+      static_cast<device_state*>(libinput_device_get_user_data(device));
+  if (state != nullptr) {
+    return state;
+  }
+  const char* name = libinput_device_get_name(device);
+  for (auto& known : devices) {
+    if (known->device == nullptr &&
+        strncmp(known->info.name, name, TRACE_DEVICE_NAME - 1) == 0) {
+      state = known.get();
+      break;
+    }
+  }
+  if (state == nullptr) {
+    devices.push_back(std::make_unique<device_state>());
+    state = devices.back().get();
+    state->id = devices.size() - 1;
+    strncpy(state->info.name, name, TRACE_DEVICE_NAME - 1);
+  }
+  state->device = device;
+  if (libinput_device_get_size(device, &state->info.width,
+                               &state->info.height) != 0) {
+    state->info.width = 0;
+    state->info.height = 0;
+  }
+  state->info.capabilities = 0;
+  for (auto cap : {LIBINPUT_DEVICE_CAP_TOUCH, LIBINPUT_DEVICE_CAP_GESTURE,
+                   LIBINPUT_DEVICE_CAP_SWITCH}) {
+    if (libinput_device_has_capability(device, cap)) {
+      state->info.capabilities |= 1U << cap;
+    }
+  }
+  state->info.usb_id = libinput_device_get_id_vendor(device) << 16 |
+                       libinput_device_get_id_product(device);
+  configure_device(state);
+  libinput_device_set_user_data(device, state);
+  return state;
+}
+
+void gebaar::io::Input::unregister_device(libinput_device* device) {
+  auto state =
+      static_cast<device_state*>(libinput_device_get_user_data(device));
+  if (state != nullptr) {
+    state->device = nullptr;
+    libinput_device_set_user_data(device, nullptr);
+  }
+}
+
+/**
+ * Add a recognizer decision to the flight recorder, stamped with the time of
+ * the event being processed
+ */
+void gebaar::io::Input::record_decision(uint32_t type, int32_t code,
+                                        int32_t value, int32_t fingers,
+                                        double x, double y) {
+  raw_event ev{};
+  ev.time = current_time;
+  ev.type = type;
+  ev.code = code;
+  ev.value = value;
+  ev.fingers = fingers;
+  ev.x = x;
+  ev.y = y;
+  recorder.record(ev);
+  if (decision_log != nullptr) {
+    decision_log->push_back(ev);
+  }
+  switch (type) {
+    case TRACE_THRESHOLD:
+      GEBAAR_PROBE4(threshold, current_time, code, value, fingers);
+      break;
+    case TRACE_REJECT:
+      GEBAAR_PROBE3(reject, current_time, code, value);
+      break;
+    case TRACE_GESTURE:
+      GEBAAR_PROBE4(gesture, current_time, code, value, fingers);
+      ++gestures;
+      usage.gesture(code, fingers, value,
+                    code == TRACE_SWITCH ? 0 : current_time - gesture_start);
+      break;
+  }
+  if (type == TRACE_REJECT) {
+    usage.rejected(code);
+  }
+  if (type == TRACE_REJECT && current_device != nullptr) {
+    adaptive.rejected(current_device);
+  }
+}
+
+/**
+ * Write the flight recorder to the runtime directory on SIGUSR1
+ */
+void gebaar::io::Input::dump_trace() {
+  std::string dir = gebaar::util::xdg_runtime_dir();
+  if (dir.empty()) {
+    spdlog::get("main")->error("No directory to write the flight recorder to");
+    return;
+  }
+  std::string path = dir + "/gebaard-" + std::to_string(getpid()) + "-" +
+                     (seat != "seat0" ? seat + "-" : "") +
+                     std::to_string(current_time) + ".trace";
+  if (recorder.dump(path, devices)) {
+    spdlog::get("main")->info("Flight recorder written to {}", path);
+  } else {
+    spdlog::get("main")->error("Could not write flight recorder to {}", path);
   }
 }
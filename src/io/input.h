@@ -31,14 +31,28 @@
 #include <map>
 #include <vector>
 #include "../config/config.h"
+#include "io/adaptive.h"
+#include "io/calibration.h"
+#include "io/device.h"
+#include "io/loop.h"
+#include "io/momentum.h"
+#include "io/pointer.h"
+#include "io/recorder.h"
+#include "io/trace.h"
+#include "io/usage.h"
+#include "process/supervisor.h"
 #define FN "input"
 #define THRESH 100
+#define TOUCH_MAX_SLOTS 10
+#define COMMAND_LINE_RESERVE 256  // rendered command length that never allocates
+#define HOLD_TOUCH_TOLERANCE 3  // mm a resting finger may drift on a touchscreen
 
 #define DEFAULT_SCALE 1.0
-#define SWIPE_X_THRESHOLD 1000
-#define SWIPE_Y_THRESHOLD 500
+#define PINCH_INTENT_MIN_PROGRESS 0.1  // of a threshold, before intent is told
 
 namespace gebaar::io {
+class Replay;
+
 struct gesture_swipe_event {
   int fingers;
   double x;
@@ -46,6 +60,18 @@ struct gesture_swipe_event {
 
   bool executed;
   int step;
+  int triggered;  // commands run, continuous swipes keep counting
+  uint64_t start_time;
+};
+
+/*
+ * What a pinch gesture turned out to be, decided on its first updates
+ */
+enum pinch_intent {
+  INTENT_UNDECIDED,
+  INTENT_PINCH,
+  INTENT_ROTATE,
+  INTENT_BOTH,
 };
 
 struct gesture_pinch_event {
@@ -57,30 +83,121 @@ struct gesture_pinch_event {
   bool continuous;
   bool rotating;
   int step;
+  uint64_t start_time;
+  pinch_intent intent;
+  int updates;  // seen while the intent is undecided
 };
 
+/*
+ * Indexed by slot, so a gesture never allocates. Touches in slots beyond
+ * TOUCH_MAX_SLOTS are not tracked, a gesture with one is rejected.
+ * down_slots and up_slots keep their capacity between gestures, see
+ * reset_touch_swipe_event.
+ */
 struct touch_swipe_event {
   size_t fingers;
   double x;
   double y;
-  std::map<size_t, std::pair<double, double>> prev_xy;
-  std::map<size_t, std::pair<double, double>> delta_xy;
+  bool moved[TOUCH_MAX_SLOTS];
+  std::pair<double, double> prev_xy[TOUCH_MAX_SLOTS];
+  std::pair<double, double> delta_xy[TOUCH_MAX_SLOTS];
+  size_t moved_slots;
+  bool held;  // a hold command ran, the fingers lifting is no swipe
+  int32_t untracked_slot;  // first slot past TOUCH_MAX_SLOTS, -1 for none
+  // Where the first finger touched down, nullptr outside every region
+  const gebaar::config::Config::touch_region* region;
   std::vector<std::pair<size_t, double>> down_slots;
   std::vector<std::pair<size_t, double>> up_slots;
 };
+
+/*
+ * The first two fingers on a touchscreen, followed as a pinch and rotation
+ * from the moment the second one touches down. Only the line between them
+ * is kept, so each frame is one update whatever the gesture's length.
+ */
+struct touch_pinch_event {
+  bool active;
+  size_t fingers;  // slots taken, a third finger ends the pinch
+  size_t slots[2];
+  double x[2];
+  double y[2];
+  double start_distance;
+  double angle;     // radians, line between the fingers at the last frame
+  bool recognized;  // a pinch or rotate command was triggered
+};
+
+/*
+ * Signs that the event loop falls behind, from libinput's own log and from
+ * the watchdog timing every event
+ */
+struct lag_stats {
+  uint64_t libinput_reports;  // "event processing lagging behind"
+  uint64_t libinput_max_ms;
+  uint64_t libinput_total_ms;
+  uint64_t client_bugs;       // libinput blaming gebaard
+  uint64_t slow_events;       // over settings.watchdog.budget_ms
+  uint64_t slow_max_usec;
+};
+
+/*
+ * Fingers resting on a touchpad (a libinput hold gesture) or on a
+ * touchscreen. The hold command runs once they rested for
+ * settings.hold.delay_ms, then repeats while they stay if configured to.
+ */
+struct hold_event {
+  bool active;
+  bool touch;
+  size_t fingers;
+  uint32_t device;
+  uint64_t start_time;
+  int step;  // commands run, repeats keep counting
+};
+
+/*
+ * A touchpad swipe moving the pointer with the button held, from its begin
+ * to its end. Deltas below a pixel are carried over to the next update.
+ */
+struct drag_event {
+  bool active;
+  size_t fingers;
+  double x;
+  double y;
+  int64_t moved_x;  // pixels sent to the pointer, recorded with the drag
+  int64_t moved_y;
+};
+
+/*
+ * Touch positions reported since the last TOUCH_FRAME
+ */
+struct touch_frame {
+  bool moved[TOUCH_MAX_SLOTS];
+  double x[TOUCH_MAX_SLOTS];
+  double y[TOUCH_MAX_SLOTS];
+  bool lifted;
+};
+
 class Input {
  public:
-  explicit Input(std::shared_ptr<gebaar::config::Config> const& config_ptr);
+  Input(std::shared_ptr<gebaar::config::Config> const& config_ptr,
+        std::shared_ptr<gebaar::process::Supervisor> const& supervisor_ptr,
+        const std::string& seat_name = "seat0");
 
   ~Input();
 
   bool initialize();
 
-  void start_loop();
+  void attach(EventLoop& loop);
+
+  std::string status() const;
 
  private:
+  friend class Replay;
+
   std::shared_ptr<gebaar::config::Config> config;
+  std::shared_ptr<gebaar::process::Supervisor> supervisor;
   std::string swipe_event_group;
+  std::string seat;
+  EventLoop* attached_loop = nullptr;
   struct libinput* libinput;
   struct libinput_event* libinput_event;
   struct udev* udev;
@@ -88,12 +205,64 @@ class Input {
   struct gesture_swipe_event gesture_swipe_event;
   struct gesture_pinch_event gesture_pinch_event;
   struct touch_swipe_event touch_swipe_event;
+  struct touch_pinch_event touch_pinch_event;
+  struct touch_frame touch_frame;
+  struct hold_event hold_event;
+  struct drag_event drag_event;
+
+  std::vector<std::unique_ptr<device_state>> devices;
+  Calibration calibration;
+  AdaptiveThresholds adaptive;
+  Momentum momentum;
+  Timer momentum_timer;
+  Timer hold_timer;
+  Timer adaptive_timer;  // writes the adaptive history off the event path
+  FlightRecorder recorder;
+  std::unique_ptr<PointerSink> pointer;  // a counting sink when replaying
+  UsageStats usage;
+  uint64_t current_time = 0;
+  uint64_t gesture_start = 0;  // first begin or touch down of the gesture
+  device_state* current_device = nullptr;
+  int dump_signal_fd = -1;
+  uint64_t gestures = 0;  // recognized, commands or not
+  uint64_t commands = 0;  // configured ones triggered, spawned or dropped
+  uint32_t momentum_device = 0;  // device of the swipe momentum carries on
+  std::vector<raw_event>* decision_log = nullptr;  // set while replaying
+  std::string command_line;  // last command rendered from a template
+  const std::string* event_command = nullptr;  // run by the current event
+  struct lag_stats lag {};
 
   bool initialize_context();
 
+  static void log_handler(struct libinput* context,
+                          enum libinput_log_priority priority,
+                          const char* format, va_list args);
+
+  void watchdog(const raw_event& ev, uint64_t elapsed_usec);
+
+  device_state* register_device(libinput_device* device);
+
+  device_state* add_device(const trace_device& info);
+
+  void configure_device(device_state* state);
+
+  /*
+   * Settings and bindings of the device the current event came from
+   */
+  const gebaar::config::Config::device_config& device_config() const {
+    return *current_device->config;
+  }
+
+  void unregister_device(libinput_device* device);
+
+  void record_decision(uint32_t type, int32_t code, int32_t value = 0,
+                       int32_t fingers = 0, double x = 0, double y = 0);
+
+  void dump_trace();
+
   bool gesture_device_exists();
 
-  bool check_chosen_event(std::string ev);
+  bool check_chosen_event(const char* ev);
 
   static int open_restricted(const char* path, int flags,
                              __attribute__((unused)) void* user_data) {
@@ -109,9 +278,15 @@ class Input {
   constexpr static struct libinput_interface libinput_interface = {
       open_restricted, close_restricted};
 
-  void check_multitouch_down_up(std::vector<std::pair<size_t, double>> slots);
+  bool runproc(const gebaar::config::CommandTemplate& command,
+               const gebaar::config::gesture_fields& fields);
 
-  void apply_swipe(size_t swipe_type, size_t fingers, std::string type);
+  void check_multitouch_down_up(
+      const std::vector<std::pair<size_t, double>>& slots);
+
+  void apply_swipe(size_t swipe_type, size_t fingers, const std::string& type,
+                   gebaar::config::gesture_fields fields,
+                   const std::string* region_type = nullptr);
 
   size_t get_swipe_type(double sdx, double sdy);
   /*
@@ -128,30 +303,74 @@ class Input {
 
   void handle_event();
 
+  bool read_event(struct libinput_event* event, raw_event* ev);
+
+  void process_event(const raw_event& ev);
+
   /* Swipe event */
   void reset_swipe_event();
 
-  void handle_swipe_event_without_coords(libinput_event_gesture* gev,
-                                         bool begin);
+  void reset_touch_swipe_event();
+
+  void handle_swipe_event_without_coords(const raw_event& ev, bool begin);
+
+  void handle_swipe_event_with_coords(const raw_event& ev);
+
+  void advance_swipe(const raw_event& ev);
+
+  bool start_momentum(const raw_event& ev);
+
+  void handle_momentum_tick(const raw_event& ev);
+
+  void stop_momentum();
+
+  void momentum_timer_expired();
+
+  bool start_drag(const raw_event& ev);
+
+  void move_drag(const raw_event& ev);
 
-  void handle_swipe_event_with_coords(libinput_event_gesture* gev);
+  void stop_drag();
 
-  void handle_touch_event_motion(libinput_event_touch* tev);
+  void handle_touch_event_motion(const raw_event& ev);
 
-  void handle_touch_event_down(libinput_event_touch* tev);
+  void handle_touch_event_down(const raw_event& ev);
 
-  void handle_touch_event_up(libinput_event_touch* tev);
+  void handle_touch_event_up(const raw_event& ev);
+
+  void handle_touch_event_frame(const raw_event& ev);
+
+  void handle_touch_event_cancel();
+
+  void move_touch_slot(size_t slot, double x, double y);
+
+  void touch_pinch_down(const raw_event& ev, size_t slot);
+
+  void touch_pinch_frame(const raw_event& ev);
+
+  void finish_touch_swipe(const raw_event& ev);
 
   void trigger_swipe_command();
 
   double get_swipe_length(double sdx, double sdy);
 
   bool test_above_threshold(size_t swipe_type, double length,
-                            libinput_device* dev);
+                            device_state* dev, double* ratio);
+
+  double gesture_swipe_ratio(const device_state& device);
+
+  void schedule_adaptive_save();
 
   /* Pinch event */
   void reset_pinch_event();
 
+  gebaar::config::gesture_fields pinch_fields(size_t pinch_type, double scale,
+                                              double angle);
+
+  void record_pinch(size_t pinch_type);
+
+  void classify_pinch_intent(double new_scale, double new_angle);
+
   void handle_one_shot_pinch(double new_scale);
 
   void handle_continuous_pinch(double new_scale);
@@ -160,9 +379,20 @@ class Input {
 
   void handle_continuous_rotate(double new_angle);
 
-  void handle_pinch_event(libinput_event_gesture* gev, bool begin);
+  void handle_pinch_event(const raw_event& ev, bool begin);
+
+  void handle_switch_event(const raw_event& ev);
+
+  /* Hold event */
+  void handle_hold_event(const raw_event& ev, bool begin);
+
+  void start_hold(const raw_event& ev, size_t fingers, bool touch);
+
+  void stop_hold();
+
+  void handle_hold_tick(const raw_event& ev);
 
-  void handle_switch_event(libinput_event_switch* gev);
+  void hold_timer_expired();
 };
 }  // namespace gebaar::io
 
@@ -0,0 +1,130 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "io/loop.h"
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cerrno>
+
+#define LOOP_MAX_EVENTS 16
+
+gebaar::io::EventLoop::EventLoop() { epoll_fd = epoll_create1(EPOLL_CLOEXEC); }
+
+gebaar::io::EventLoop::~EventLoop() { close(epoll_fd); }
+
+/**
+ * Call callback whenever fd becomes readable
+ *
+ * @param fd file descriptor to watch, owned by the caller
+ * @param callback handler run on the loop thread
+ * @return bool
+ */
+bool gebaar::io::EventLoop::watch(int fd, std::function<void()> callback) {
+  if (fd < 0 || watchers.count(fd)) {
+    return false;
+  }
+  auto w = std::make_unique<watcher>();
+  w->fd = fd;
+  w->callback = std::move(callback);
+  struct epoll_event ev {};
+  ev.events = EPOLLIN;
+  ev.data.ptr = w.get();
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    return false;
+  }
+  watchers[fd] = std::move(w);
+  return true;
+}
+
+void gebaar::io::EventLoop::unwatch(int fd) {
+  auto iter = watchers.find(fd);
+  if (iter == watchers.end()) {
+    return;
+  }
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+  iter->second->callback = nullptr;
+  retired.push_back(std::move(iter->second));
+  watchers.erase(iter);
+}
+
+/**
+ * Dispatch readable file descriptors until stop() is called
+ */
+void gebaar::io::EventLoop::run() {
+  struct epoll_event events[LOOP_MAX_EVENTS];
+  running = true;
+  while (running) {
+    int count = epoll_wait(epoll_fd, events, LOOP_MAX_EVENTS, -1);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    for (int i = 0; i < count; ++i) {
+      auto w = static_cast<watcher*>(events[i].data.ptr);
+      if (w->callback) {
+        w->callback();
+      }
+    }
+    retired.clear();
+  }
+}
+
+gebaar::io::Timer::Timer() {
+  timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+}
+
+gebaar::io::Timer::~Timer() { close(timer_fd); }
+
+/**
+ * Arm the timer, replacing any pending expiration
+ *
+ * @param delay_ms time until the first expiration, 0 fires right away
+ * @param interval_ms period of following expirations, 0 for a one shot timer
+ */
+void gebaar::io::Timer::arm(uint64_t delay_ms, uint64_t interval_ms) {
+  struct itimerspec spec {};
+  spec.it_value.tv_sec = delay_ms / 1000;
+  spec.it_value.tv_nsec = (delay_ms % 1000) * 1000000;
+  if (delay_ms == 0) {
+    spec.it_value.tv_nsec = 1;  // a zero it_value would disarm
+  }
+  spec.it_interval.tv_sec = interval_ms / 1000;
+  spec.it_interval.tv_nsec = (interval_ms % 1000) * 1000000;
+  timerfd_settime(timer_fd, 0, &spec, nullptr);
+}
+
+void gebaar::io::Timer::disarm() {
+  struct itimerspec spec {};
+  timerfd_settime(timer_fd, 0, &spec, nullptr);
+}
+
+/**
+ * Acknowledge the timer, must be called from its loop callback
+ *
+ * @return number of expirations since the last call
+ */
+uint64_t gebaar::io::Timer::expirations() {
+  uint64_t count = 0;
+  if (read(timer_fd, &count, sizeof(count)) != sizeof(count)) {
+    return 0;
+  }
+  return count;
+}
@@ -0,0 +1,86 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SRC_IO_LOOP_H_
+#define SRC_IO_LOOP_H_
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace gebaar::io {
+/*
+ * Single threaded epoll loop. Every source gebaard reacts to (libinput,
+ * signals, timers) is a file descriptor registered here.
+ */
+class EventLoop {
+ public:
+  EventLoop();
+  ~EventLoop();
+
+  EventLoop(const EventLoop&) = delete;
+  EventLoop& operator=(const EventLoop&) = delete;
+
+  bool watch(int fd, std::function<void()> callback);
+
+  void unwatch(int fd);
+
+  void run();
+
+  void stop() { running = false; }
+
+ private:
+  struct watcher {
+    int fd;
+    std::function<void()> callback;
+  };
+
+  int epoll_fd;
+  bool running = false;
+  std::map<int, std::unique_ptr<watcher>> watchers;
+  // Watchers removed from inside a callback, freed after the current batch
+  std::vector<std::unique_ptr<watcher>> retired;
+};
+
+/*
+ * Monotonic timerfd, registered with an EventLoop by its owner
+ */
+class Timer {
+ public:
+  Timer();
+  ~Timer();
+
+  Timer(const Timer&) = delete;
+  Timer& operator=(const Timer&) = delete;
+
+  int fd() const { return timer_fd; }
+
+  void arm(uint64_t delay_ms, uint64_t interval_ms = 0);
+
+  void disarm();
+
+  uint64_t expirations();
+
+ private:
+  int timer_fd;
+};
+}  // namespace gebaar::io
+
+#endif  // SRC_IO_LOOP_H_
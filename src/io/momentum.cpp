@@ -0,0 +1,110 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "io/momentum.h"
+#include <cmath>
+
+/**
+ * Remember one update of the swipe
+ *
+ * @param dx unaccelerated delta
+ * @param dy unaccelerated delta
+ * @param time usec
+ */
+void gebaar::io::Momentum::track(double dx, double dy, uint64_t time) {
+  samples[next] = {time, dx, dy};
+  next = (next + 1) % MOMENTUM_SAMPLES;
+  if (count < MOMENTUM_SAMPLES) {
+    ++count;
+  }
+}
+
+/**
+ * Take the release velocity from the updates tracked since the last stop
+ *
+ * @param time usec the fingers lifted at
+ * @param decay_ms time constant, the velocity falls to 37% in that time
+ * @return bool false if the fingers rested before lifting, or too few
+ * updates were tracked to tell
+ */
+bool gebaar::io::Momentum::start(uint64_t time, double decay_ms) {
+  if (count < 2 || decay_ms <= 0) {
+    stop();
+    return false;
+  }
+  const sample& newest =
+      samples[(next + MOMENTUM_SAMPLES - 1) % MOMENTUM_SAMPLES];
+  if (time - newest.time > MOMENTUM_WINDOW_USEC) {
+    stop();
+    return false;
+  }
+  // The oldest sample in the window only marks where it starts, its own
+  // delta was covered before that
+  double dx = 0;
+  double dy = 0;
+  uint64_t since = newest.time;
+  for (size_t i = 2; i <= count; ++i) {
+    const sample& s = samples[(next + MOMENTUM_SAMPLES - i) % MOMENTUM_SAMPLES];
+    if (newest.time - s.time > MOMENTUM_WINDOW_USEC) {
+      break;
+    }
+    const sample& newer =
+        samples[(next + MOMENTUM_SAMPLES - i + 1) % MOMENTUM_SAMPLES];
+    dx += newer.dx;
+    dy += newer.dy;
+    since = s.time;
+  }
+  if (since == newest.time) {
+    stop();
+    return false;
+  }
+  velocity_x = dx / (newest.time - since);
+  velocity_y = dy / (newest.time - since);
+  decay_usec = decay_ms * 1000;
+  last_time = time;
+  count = 0;
+  running = true;
+  return true;
+}
+
+/**
+ * Distance covered since the last tick, slowing down as it goes
+ *
+ * @param time usec of this tick
+ * @param dx receives the delta
+ * @param dy receives the delta
+ */
+void gebaar::io::Momentum::advance(uint64_t time, double* dx, double* dy) {
+  double elapsed = time > last_time ? time - last_time : 0;
+  double remaining = exp(-elapsed / decay_usec);
+  *dx = velocity_x * decay_usec * (1 - remaining);
+  *dy = velocity_y * decay_usec * (1 - remaining);
+  velocity_x *= remaining;
+  velocity_y *= remaining;
+  last_time = time;
+}
+
+/**
+ * Stop moving and forget the tracked updates
+ */
+void gebaar::io::Momentum::stop() {
+  running = false;
+  velocity_x = 0;
+  velocity_y = 0;
+  count = 0;
+}
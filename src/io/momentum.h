@@ -0,0 +1,77 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SRC_IO_MOMENTUM_H_
+#define SRC_IO_MOMENTUM_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#define MOMENTUM_SAMPLES 8
+#define MOMENTUM_WINDOW_USEC 50000  // updates the release velocity is taken from
+#define MOMENTUM_TICK_MS 16
+
+namespace gebaar::io {
+/*
+ * Keeps a continuous swipe going after the fingers lift. The release
+ * velocity is the motion of the last updates before the fingers lift, it
+ * then decays exponentially, so the distance left to cover is known from
+ * the start and each tick only needs one exp().
+ */
+class Momentum {
+ public:
+  void track(double dx, double dy, uint64_t time);
+
+  bool start(uint64_t time, double decay_ms);
+
+  void advance(uint64_t time, double* dx, double* dy);
+
+  void stop();
+
+  bool active() const { return running; }
+
+  /*
+   * Speed in steps per second, given the distance of one step on each axis
+   */
+  double rate(double step_x, double step_y) const {
+    double rx = (velocity_x < 0 ? -velocity_x : velocity_x) / step_x;
+    double ry = (velocity_y < 0 ? -velocity_y : velocity_y) / step_y;
+    return (rx > ry ? rx : ry) * 1000000;
+  }
+
+ private:
+  struct sample {
+    uint64_t time;
+    double dx;
+    double dy;
+  };
+
+  // Ring of the last updates, so tracking never allocates
+  sample samples[MOMENTUM_SAMPLES];
+  size_t next = 0;
+  size_t count = 0;
+
+  bool running = false;
+  double velocity_x = 0;  // gesture delta units per usec
+  double velocity_y = 0;
+  double decay_usec = 0;
+  uint64_t last_time = 0;
+};
+}  // namespace gebaar::io
+
+#endif  // SRC_IO_MOMENTUM_H_
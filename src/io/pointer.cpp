@@ -0,0 +1,102 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "io/pointer.h"
+#include <fcntl.h>
+#include <linux/uinput.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <cstring>
+#include "config/config.h"
+
+#define FN "pointer"
+#define UINPUT_PATH "/dev/uinput"
+#define UINPUT_NAME "gebaard pointer"
+
+gebaar::io::UinputPointer::~UinputPointer() {
+  if (uinput_fd >= 0) {
+    ioctl(uinput_fd, UI_DEV_DESTROY);
+    close(uinput_fd);
+  }
+}
+
+/**
+ * Create the virtual device, once. Done ahead of the first drag, the
+ * compositor needs a moment to pick a new device up.
+ *
+ * @return bool false if uinput isn't available to us
+ */
+bool gebaar::io::UinputPointer::open() {
+  if (uinput_fd >= 0 || failed) {
+    return uinput_fd >= 0;
+  }
+  uinput_fd = ::open(UINPUT_PATH, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+  struct uinput_setup setup {};
+  setup.id.bustype = BUS_VIRTUAL;
+  strncpy(setup.name, UINPUT_NAME, UINPUT_MAX_NAME_SIZE - 1);
+  if (uinput_fd < 0 || ioctl(uinput_fd, UI_SET_EVBIT, EV_KEY) < 0 ||
+      ioctl(uinput_fd, UI_SET_KEYBIT, BTN_LEFT) < 0 ||
+      ioctl(uinput_fd, UI_SET_EVBIT, EV_REL) < 0 ||
+      ioctl(uinput_fd, UI_SET_RELBIT, REL_X) < 0 ||
+      ioctl(uinput_fd, UI_SET_RELBIT, REL_Y) < 0 ||
+      ioctl(uinput_fd, UI_DEV_SETUP, &setup) < 0 ||
+      ioctl(uinput_fd, UI_DEV_CREATE) < 0) {
+    spdlog::get("main")->error(
+        "[{}] at {} - can't create a pointer through {}: {}, drags are off",
+        FN, __LINE__, UINPUT_PATH, strerror(errno));
+    if (uinput_fd >= 0) {
+      close(uinput_fd);
+      uinput_fd = -1;
+    }
+    failed = true;
+    return false;
+  }
+  return true;
+}
+
+void gebaar::io::UinputPointer::button(bool pressed) {
+  struct input_event events[2] {};
+  events[0].type = EV_KEY;
+  events[0].code = BTN_LEFT;
+  events[0].value = pressed ? 1 : 0;
+  events[1].type = EV_SYN;
+  events[1].code = SYN_REPORT;
+  emit(events, sizeof(events));
+}
+
+/**
+ * Move the pointer, one write for both axes and the report
+ */
+void gebaar::io::UinputPointer::move(int dx, int dy) {
+  struct input_event events[3] {};
+  events[0].type = EV_REL;
+  events[0].code = REL_X;
+  events[0].value = dx;
+  events[1].type = EV_REL;
+  events[1].code = REL_Y;
+  events[1].value = dy;
+  events[2].type = EV_SYN;
+  events[2].code = SYN_REPORT;
+  emit(events, sizeof(events));
+}
+
+void gebaar::io::UinputPointer::emit(const void* events, size_t size) {
+  if (uinput_fd >= 0 && write(uinput_fd, events, size) < 0) {
+    spdlog::get("main")->debug("[{}] at {} - uinput write failed: {}", FN,
+                               __LINE__, strerror(errno));
+  }
+}
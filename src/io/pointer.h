@@ -0,0 +1,65 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SRC_IO_POINTER_H_
+#define SRC_IO_POINTER_H_
+
+#include <cstddef>
+
+namespace gebaar::io {
+/*
+ * Where pointer output of drag gestures goes. Input only talks to this, so
+ * drags can be checked against a sink that records them instead.
+ */
+class PointerSink {
+ public:
+  virtual ~PointerSink() = default;
+
+  virtual bool open() = 0;
+
+  virtual void button(bool pressed) = 0;
+
+  virtual void move(int dx, int dy) = 0;
+};
+
+/*
+ * Virtual relative pointer with a left button, created through /dev/uinput.
+ * The compositor sees it as a mouse and accelerates its motion as such.
+ */
+class UinputPointer : public PointerSink {
+ public:
+  UinputPointer() = default;
+  ~UinputPointer() override;
+
+  UinputPointer(const UinputPointer&) = delete;
+  UinputPointer& operator=(const UinputPointer&) = delete;
+
+  bool open() override;
+
+  void button(bool pressed) override;
+
+  void move(int dx, int dy) override;
+
+ private:
+  void emit(const void* events, size_t size);
+
+  int uinput_fd = -1;
+  bool failed = false;  // don't retry on every device added
+};
+}  // namespace gebaar::io
+
+#endif  // SRC_IO_POINTER_H_
@@ -0,0 +1,72 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "io/recorder.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+
+static_assert((FLIGHT_RECORDER_SIZE & (FLIGHT_RECORDER_SIZE - 1)) == 0,
+              "FLIGHT_RECORDER_SIZE must be a power of two");
+
+gebaar::io::FlightRecorder::FlightRecorder()
+    : ring(new raw_event[FLIGHT_RECORDER_SIZE]()) {}
+
+/**
+ * Write the ring to path in the trace format. The file must not exist yet,
+ * a symlink or file planted under its name is never written through.
+ *
+ * @param path file to create
+ * @param devices device table the records' device field indexes
+ * @return bool
+ */
+bool gebaar::io::FlightRecorder::dump(
+    const std::string& path,
+    const std::vector<std::unique_ptr<device_state>>& devices) const {
+  int fd = open(path.c_str(),
+                O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    return false;
+  }
+  FILE* file = fdopen(fd, "wb");
+  if (file == nullptr) {
+    close(fd);
+    return false;
+  }
+  uint64_t count = head < FLIGHT_RECORDER_SIZE ? head : FLIGHT_RECORDER_SIZE;
+  uint64_t first = head - count;
+
+  trace_header header{};
+  header.magic = TRACE_MAGIC;
+  header.version = TRACE_VERSION;
+  header.record_size = sizeof(raw_event);
+  header.device_count = devices.size();
+  header.record_count = count;
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+  for (const auto& device : devices) {
+    ok = ok && fwrite(&device->info, sizeof(device->info), 1, file) == 1;
+  }
+  // The ring wraps at most once, so this is at most two contiguous writes
+  uint64_t start = first & (FLIGHT_RECORDER_SIZE - 1);
+  uint64_t tail = std::min<uint64_t>(count, FLIGHT_RECORDER_SIZE - start);
+  ok = ok && fwrite(&ring[start], sizeof(raw_event), tail, file) == tail;
+  ok = ok && fwrite(&ring[0], sizeof(raw_event), count - tail, file) ==
+                 count - tail;
+  return (fclose(file) == 0) && ok;
+}
@@ -0,0 +1,52 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SRC_IO_RECORDER_H_
+#define SRC_IO_RECORDER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "io/device.h"
+#include "io/trace.h"
+
+#define FLIGHT_RECORDER_SIZE 8192  // must be a power of two
+
+namespace gebaar::io {
+/*
+ * Always-on ring of the last FLIGHT_RECORDER_SIZE events and decisions.
+ * Recording is a single 64 byte copy, the ring is only walked when dumped.
+ */
+class FlightRecorder {
+ public:
+  FlightRecorder();
+
+  void record(const raw_event& ev) {
+    ring[head++ & (FLIGHT_RECORDER_SIZE - 1)] = ev;
+  }
+
+  bool dump(const std::string& path,
+            const std::vector<std::unique_ptr<device_state>>& devices) const;
+
+ private:
+  std::unique_ptr<raw_event[]> ring;
+  uint64_t head = 0;
+};
+}  // namespace gebaar::io
+
+#endif  // SRC_IO_RECORDER_H_
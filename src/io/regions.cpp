@@ -0,0 +1,54 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "io/regions.h"
+#define FN "regions"
+
+/**
+ * Fill the grid, called when the device is added
+ *
+ * @param list regions of the device's [[device]] section, in the order they
+ * take precedence. Kept by pointer, the configuration outlives devices.
+ */
+void gebaar::io::TouchRegions::configure(
+    const std::vector<gebaar::config::Config::touch_region>& list) {
+  regions = &list;
+  cells.clear();
+  if (list.empty()) {
+    return;
+  }
+  if (list.size() > UINT8_MAX) {
+    spdlog::get("main")->error("[{}] at {} - Only the first {} regions are used",
+                               FN, __LINE__, UINT8_MAX);
+  }
+  cells.assign(REGION_GRID * REGION_GRID, 0);
+  for (size_t column = 0; column < REGION_GRID; ++column) {
+    double x = (column + 0.5) * 100 / REGION_GRID;
+    for (size_t row = 0; row < REGION_GRID; ++row) {
+      double y = (row + 0.5) * 100 / REGION_GRID;
+      for (size_t i = 0; i < list.size() && i < UINT8_MAX; ++i) {
+        const auto& region = list[i];
+        if (x >= region.x && x < region.x + region.width && y >= region.y &&
+            y < region.y + region.height) {
+          cells[column * REGION_GRID + row] = i + 1;
+          break;
+        }
+      }
+    }
+  }
+}
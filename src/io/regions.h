@@ -0,0 +1,63 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SRC_IO_REGIONS_H_
+#define SRC_IO_REGIONS_H_
+
+#include <cstdint>
+#include <vector>
+#include "config/config.h"
+
+#define REGION_GRID 100  // cells per axis, 1% of the device each
+
+namespace gebaar::io {
+/*
+ * The touchscreen regions of a device, compiled into a grid when the device
+ * is added. Each cell holds the first region covering its center, so finding
+ * where a swipe starts is one lookup however many regions there are.
+ */
+class TouchRegions {
+ public:
+  void configure(const std::vector<gebaar::config::Config::touch_region>& list);
+
+  /*
+   * Region a touch at x, y (mm) starts in, nullptr if none or the size of
+   * the device is unknown
+   */
+  const gebaar::config::Config::touch_region* locate(double x, double y,
+                                                     double width,
+                                                     double height) const {
+    if (cells.empty() || width <= 0 || height <= 0) {
+      return nullptr;
+    }
+    uint8_t region = cells[cell(x, width) * REGION_GRID + cell(y, height)];
+    return region == 0 ? nullptr : &(*regions)[region - 1];
+  }
+
+ private:
+  static size_t cell(double position, double size) {
+    double index = position * REGION_GRID / size;
+    return index < 0 ? 0 : index >= REGION_GRID ? REGION_GRID - 1 : index;
+  }
+
+  const std::vector<gebaar::config::Config::touch_region>* regions = nullptr;
+  std::vector<uint8_t> cells;  // by column then row, region index + 1
+};
+}  // namespace gebaar::io
+
+#endif  // SRC_IO_REGIONS_H_
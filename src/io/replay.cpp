@@ -0,0 +1,256 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "io/replay.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include "utils/alloc_audit.h"
+
+gebaar::io::Replay::Replay(
+    std::shared_ptr<gebaar::config::Config> const& config_ptr,
+    uint64_t budget_usec)
+    : config(config_ptr), budget_nsec(budget_usec * 1000) {}
+
+/*
+ * Stands in for the uinput pointer, counting what drags would have sent
+ */
+class ReplayPointer : public gebaar::io::PointerSink {
+ public:
+  bool open() override { return true; }
+
+  void button(bool pressed) override {
+    (pressed ? presses : releases)++;
+  }
+
+  void move(int dx, int dy) override {
+    moves++;
+    x += dx;
+    y += dy;
+  }
+
+  size_t presses = 0;
+  size_t releases = 0;
+  size_t moves = 0;
+  int64_t x = 0;
+  int64_t y = 0;
+};
+
+/**
+ * Read a trace
+ *
+ * @param path trace written on SIGUSR1
+ * @return bool false if the file is missing, damaged or of another version
+ */
+bool gebaar::io::Replay::load(const std::string& path) {
+  FILE* file = fopen(path.c_str(), "rbe");
+  if (file == nullptr) {
+    spdlog::get("main")->error("Can't open trace {}", path);
+    return false;
+  }
+  trace_header header{};
+  bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+            header.magic == TRACE_MAGIC && header.version == TRACE_VERSION &&
+            header.record_size == sizeof(raw_event);
+  if (ok) {
+    trace_devices.resize(header.device_count);
+    records.resize(header.record_count);
+    ok = fread(trace_devices.data(), sizeof(trace_device),
+               trace_devices.size(), file) == trace_devices.size() &&
+         fread(records.data(), sizeof(raw_event), records.size(), file) ==
+             records.size();
+  }
+  fclose(file);
+  for (const auto& record : records) {
+    ok = ok && record.device < trace_devices.size();
+  }
+  if (!ok) {
+    spdlog::get("main")->error("{} is not a trace of this gebaard version",
+                               path);
+  }
+  return ok;
+}
+
+/**
+ * Replay every input event of the trace, timing each one
+ *
+ * @return bool true if the same gestures were recognized within budget
+ */
+bool gebaar::io::Replay::run() {
+  Input input(config, nullptr);
+  auto pointer = std::make_unique<ReplayPointer>();
+  const ReplayPointer& drags = *pointer;
+  input.pointer = std::move(pointer);
+  std::vector<raw_event> replayed;
+  // No event records more decisions than this, growing the log while
+  // replaying would count as an allocation of the gesture path
+  replayed.reserve(records.size() * REPLAY_DECISIONS_PER_EVENT);
+  input.decision_log = &replayed;
+
+  // What initialize() would have found, unless the configuration decides
+  const auto& interact_type = config->settings.interact_type;
+  if (interact_type == "BOTH" || interact_type == "TOUCH" ||
+      interact_type == "GESTURE") {
+    input.swipe_event_group = interact_type;
+  }
+  for (const auto& info : trace_devices) {
+    input.add_device(info);
+    if (input.swipe_event_group.empty() &&
+        (info.capabilities & (1U << LIBINPUT_DEVICE_CAP_GESTURE))) {
+      input.swipe_event_group = "GESTURE";
+    }
+  }
+  for (const auto& info : trace_devices) {
+    if (input.swipe_event_group.empty() &&
+        (info.capabilities & (1U << LIBINPUT_DEVICE_CAP_TOUCH))) {
+      input.swipe_event_group = "TOUCH";
+    }
+  }
+
+  std::vector<uint64_t> durations;
+  durations.reserve(records.size());
+  uint64_t allocations = 0;
+  for (const auto& record : records) {
+    if (record.type >= TRACE_THRESHOLD && record.type != TRACE_MOMENTUM &&
+        record.type != TRACE_HOLD_TICK) {
+      continue;
+    }
+    // Warmed up once the trace's first gesture went through
+    bool warm = input.gestures > 0;
+    uint64_t before = gebaar::util::thread_allocations();
+    auto start = std::chrono::steady_clock::now();
+    input.process_event(record);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    if (warm) {
+      allocations += gebaar::util::thread_allocations() - before;
+    }
+    durations.push_back(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+  }
+
+  bool passed = compare_gestures(replayed);
+  if (!durations.empty()) {
+    uint64_t total = std::accumulate(durations.begin(), durations.end(),
+                                     uint64_t{0});
+    spdlog::get("main")->info("{} events in {} ns, {} events/s",
+                              durations.size(), total,
+                              durations.size() * 1000000000 /
+                                  std::max<uint64_t>(total, 1));
+    std::sort(durations.begin(), durations.end());
+    uint64_t over = durations.end() - std::upper_bound(durations.begin(),
+                                                       durations.end(),
+                                                       budget_nsec);
+    // Nearest rank, so a short trace is held to its slowest event
+    uint64_t p99 = durations[(durations.size() * 99 + 99) / 100 - 1];
+    spdlog::get("main")->info(
+        "{} events, median {} ns, p99 {} ns, max {} ns, {} over budget",
+        durations.size(), durations[durations.size() / 2], p99,
+        durations.back(), over);
+    if (p99 > budget_nsec) {
+      spdlog::get("main")->error("p99 of {} ns is over the budget of {} ns",
+                                 p99, budget_nsec);
+      passed = false;
+    }
+  }
+  if (drags.presses > 0) {
+    spdlog::get("main")->info("{} drags, {} pointer moves by {} x {}",
+                              drags.presses, drags.moves, drags.x, drags.y);
+  }
+  // What the drags recognized say they moved must have reached the pointer
+  int64_t drag_x = 0;
+  int64_t drag_y = 0;
+  for (const auto& record : replayed) {
+    if (record.type == TRACE_GESTURE && record.code == TRACE_DRAG) {
+      drag_x += static_cast<int64_t>(record.x);
+      drag_y += static_cast<int64_t>(record.y);
+    }
+  }
+  if (drag_x != drags.x || drag_y != drags.y) {
+    spdlog::get("main")->error(
+        "Drags moved the pointer by {} x {}, not {} x {}", drags.x, drags.y,
+        drag_x, drag_y);
+    passed = false;
+  }
+  if (drags.presses != drags.releases) {
+    spdlog::get("main")->error("Button pressed {} times, released {} times",
+                               drags.presses, drags.releases);
+    passed = false;
+  }
+  if (allocations > 0) {
+    spdlog::get("main")->error("{} allocations after the first gesture",
+                               allocations);
+    passed = false;
+  }
+  return passed;
+}
+
+/**
+ * Check that the gestures recognized while replaying are the ones the trace
+ * recorded, in the same order
+ */
+bool gebaar::io::Replay::compare_gestures(
+    const std::vector<raw_event>& replayed) {
+  std::vector<const raw_event*> expected;
+  std::vector<const raw_event*> actual;
+  for (const auto& record : records) {
+    if (record.type == TRACE_GESTURE) {
+      expected.push_back(&record);
+    }
+  }
+  for (const auto& record : replayed) {
+    if (record.type == TRACE_GESTURE) {
+      actual.push_back(&record);
+    }
+  }
+  // Drags must also have moved the pointer as far
+  auto same = [](const raw_event* a, const raw_event* b) {
+    return a->code == b->code && a->value == b->value &&
+           a->fingers == b->fingers &&
+           (a->code != TRACE_DRAG || (a->x == b->x && a->y == b->y));
+  };
+  auto mismatch = std::mismatch(expected.begin(), expected.end(),
+                                actual.begin(), actual.end(), same);
+  if (mismatch.first == expected.end() && mismatch.second == actual.end()) {
+    spdlog::get("main")->info("{} gestures recognized as recorded",
+                              expected.size());
+    return true;
+  }
+  size_t index = mismatch.first - expected.begin();
+  auto describe = [](const std::vector<const raw_event*>& gestures,
+                     std::vector<const raw_event*>::iterator it) {
+    if (it == gestures.end()) {
+      return std::string("nothing");
+    }
+    std::string motion;
+    if ((*it)->code == TRACE_DRAG) {
+      motion = " moving " + std::to_string(static_cast<int64_t>((*it)->x)) +
+               " x " + std::to_string(static_cast<int64_t>((*it)->y));
+    }
+    return "gesture " + std::to_string((*it)->code) + " direction " +
+           std::to_string((*it)->value) + " with " +
+           std::to_string((*it)->fingers) + " fingers" + motion + " at " +
+           std::to_string((*it)->time) + " us";
+  };
+  spdlog::get("main")->error(
+      "Gesture {} differs: recorded {}, recognized {} ({} recorded, {} "
+      "recognized)",
+      index + 1, describe(expected, mismatch.first),
+      describe(actual, mismatch.second), expected.size(), actual.size());
+  return false;
+}
@@ -0,0 +1,59 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SRC_IO_REPLAY_H_
+#define SRC_IO_REPLAY_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "config/config.h"
+#include "io/input.h"
+#include "io/trace.h"
+
+#define REPLAY_BUDGET_USEC 1000  // p99 per event, default for --budget
+#define REPLAY_DECISIONS_PER_EVENT 8  // at most, recorded while replaying
+
+namespace gebaar::io {
+/*
+ * Feeds a trace written by the flight recorder back through the
+ * recognizers. Commands are not run. The gestures recognized now must be
+ * the ones recorded in the trace, and 99% of the events must be processed
+ * within the budget. Built with GEBAAR_ALLOC_AUDIT, no event after the
+ * first gesture may allocate either.
+ */
+class Replay {
+ public:
+  Replay(std::shared_ptr<gebaar::config::Config> const& config_ptr,
+         uint64_t budget_usec);
+
+  bool load(const std::string& path);
+
+  bool run();
+
+ private:
+  bool compare_gestures(const std::vector<raw_event>& replayed);
+
+  std::shared_ptr<gebaar::config::Config> config;
+  uint64_t budget_nsec;
+  std::vector<trace_device> trace_devices;
+  std::vector<raw_event> records;
+};
+}  // namespace gebaar::io
+
+#endif  // SRC_IO_REPLAY_H_
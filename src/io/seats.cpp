@@ -0,0 +1,213 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "io/seats.h"
+#include <libudev.h>
+#include <spdlog/spdlog.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <algorithm>
+#include "process/session.h"
+#include "utils/xdg.h"
+
+/**
+ * SeatManager constructor
+ *
+ * @param loop event loop every seat is attached to
+ */
+gebaar::io::SeatManager::SeatManager(EventLoop& loop) : loop(loop) {}
+
+gebaar::io::SeatManager::~SeatManager() {
+  // Inputs go before their supervisors, see the order in seat
+  seats.clear();
+  if (inotify_fd >= 0) {
+    loop.unwatch(inotify_fd);
+    close(inotify_fd);
+  }
+}
+
+/**
+ * Open every seat with an active user and follow logind's seat state
+ *
+ * @return bool false if not running as root or logind isn't there
+ */
+bool gebaar::io::SeatManager::start() {
+  if (geteuid() != 0) {
+    spdlog::get("main")->error("[{}] at {} - serving seats requires root",
+                               FN, __LINE__);
+    return false;
+  }
+  inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd < 0 ||
+      inotify_add_watch(inotify_fd, SEATS_DIR,
+                        IN_CREATE | IN_DELETE | IN_MOVED_TO |
+                            IN_CLOSE_WRITE) < 0) {
+    spdlog::get("main")->error("[{}] at {} - can't watch {}, is logind running?",
+                               FN, __LINE__, SEATS_DIR);
+    return false;
+  }
+  loop.watch(inotify_fd, [this] {
+    char buffer[4096];
+    while (read(inotify_fd, buffer, sizeof(buffer)) > 0) {
+    }
+    refresh();
+  });
+  refresh();
+  return true;
+}
+
+/**
+ * Each open seat and what it handled so far, for the service manager
+ */
+std::string gebaar::io::SeatManager::status() const {
+  if (seats.empty()) {
+    return "No seat with a logged in user";
+  }
+  std::string text;
+  for (const auto& entry : seats) {
+    if (!text.empty()) {
+      text += "; ";
+    }
+    text += entry.first + ": " + entry.second.input->status();
+  }
+  return text;
+}
+
+/**
+ * Input devices udev assigned to seat, to notice when they change
+ *
+ * @param name seat name
+ * @return std::vector<std::string> sorted device paths
+ */
+static std::vector<std::string> seat_devices(const std::string& name) {
+  std::vector<std::string> devices;
+  struct udev* udev = udev_new();
+  if (udev == nullptr) {
+    return devices;
+  }
+  struct udev_enumerate* enumerate = udev_enumerate_new(udev);
+  udev_enumerate_add_match_subsystem(enumerate, "input");
+  udev_enumerate_add_match_sysname(enumerate, "event*");
+  udev_enumerate_scan_devices(enumerate);
+  struct udev_list_entry* entry;
+  udev_list_entry_foreach(entry, udev_enumerate_get_list_entry(enumerate)) {
+    const char* path = udev_list_entry_get_name(entry);
+    struct udev_device* device = udev_device_new_from_syspath(udev, path);
+    if (device == nullptr) {
+      continue;
+    }
+    // Devices without ID_SEAT belong to seat0, as libinput sees it
+    const char* seat = udev_device_get_property_value(device, "ID_SEAT");
+    if (name == (seat != nullptr ? seat : "seat0")) {
+      devices.emplace_back(path);
+    }
+    udev_device_unref(device);
+  }
+  udev_enumerate_unref(enumerate);
+  udev_unref(udev);
+  std::sort(devices.begin(), devices.end());
+  return devices;
+}
+
+/**
+ * Bring the open seats in line with logind: close seats that are gone or
+ * whose active user changed, and open the others. Seats that had no gesture
+ * device are left alone until their user or devices change.
+ */
+void gebaar::io::SeatManager::refresh() {
+  auto names = gebaar::process::list_seats();
+  for (auto iter = seats.begin(); iter != seats.end();) {
+    if (std::find(names.begin(), names.end(), iter->first) == names.end()) {
+      spdlog::get("main")->info("{} removed", iter->first);
+      iter = seats.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+  for (auto iter = failed.begin(); iter != failed.end();) {
+    if (std::find(names.begin(), names.end(), iter->first) == names.end()) {
+      iter = failed.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+
+  for (const auto& name : names) {
+    gebaar::process::session_user user;
+    bool active = gebaar::process::active_user(name, &user);
+    auto found = seats.find(name);
+    if (found != seats.end()) {
+      if (active && found->second.uid == user.uid) {
+        continue;
+      }
+      spdlog::get("main")->info("{}: user {} left", name, found->second.uid);
+      seats.erase(found);
+    }
+    if (!active) {
+      failed.erase(name);
+      continue;
+    }
+    // Every session change on any seat lands here, don't retry a seat
+    // that had no gesture device while nothing on it changed
+    auto devices = seat_devices(name);
+    auto tried = failed.find(name);
+    if (tried != failed.end() && tried->second.uid == user.uid &&
+        tried->second.devices == devices) {
+      continue;
+    }
+    if (open_seat(name, user)) {
+      spdlog::get("main")->info("{}: serving {}", name, user.name);
+      failed.erase(name);
+    } else {
+      failed[name] = {user.uid, std::move(devices)};
+    }
+  }
+}
+
+/**
+ * Start recognizing gestures on a seat for user
+ *
+ * @param name seat name
+ * @param user user commands run as, whose configuration is loaded
+ * @return bool false if the seat has no gesture device
+ */
+bool gebaar::io::SeatManager::open_seat(
+    const std::string& name, const gebaar::process::session_user& user) {
+  seat opened;
+  opened.uid = user.uid;
+  std::string state_dir = gebaar::util::xdg_state_dir();
+  opened.config = std::make_shared<gebaar::config::Config>(
+      user.home + "/.config",
+      state_dir.empty()
+          ? ""
+          : state_dir + "/gebaard-" + std::to_string(user.uid) + ".cache",
+      user.uid);
+  opened.supervisor = std::make_shared<gebaar::process::Supervisor>(
+      loop, opened.config->settings.command_timeout,
+      opened.config->settings.command_kill_grace);
+  opened.supervisor->run_as(user);
+  opened.input =
+      std::make_unique<Input>(opened.config, opened.supervisor, name);
+  if (!opened.input->initialize()) {
+    spdlog::get("main")->info("{}: no gesture device", name);
+    return false;
+  }
+  opened.input->attach(loop);
+  seats.emplace(name, std::move(opened));
+  return true;
+}
@@ -0,0 +1,80 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SRC_IO_SEATS_H_
+#define SRC_IO_SEATS_H_
+
+#include <sys/types.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "config/config.h"
+#include "io/input.h"
+#include "io/loop.h"
+#include "process/supervisor.h"
+
+namespace gebaar::io {
+/*
+ * Serves every seat systemd-logind knows from one process. Each seat with a
+ * logged in user gets its own libinput context, configuration and supervisor
+ * running commands as that user. Seats are rebuilt when the active session
+ * changes.
+ */
+class SeatManager {
+ public:
+  explicit SeatManager(EventLoop& loop);
+  ~SeatManager();
+
+  SeatManager(const SeatManager&) = delete;
+  SeatManager& operator=(const SeatManager&) = delete;
+
+  bool start();
+
+  std::string status() const;
+
+ private:
+  struct seat {
+    uid_t uid;
+    std::shared_ptr<gebaar::config::Config> config;
+    std::shared_ptr<gebaar::process::Supervisor> supervisor;
+    std::unique_ptr<Input> input;
+  };
+
+  /*
+   * A seat without a gesture device, not opened again until the user or
+   * the devices on it change
+   */
+  struct failed_seat {
+    uid_t uid;
+    std::vector<std::string> devices;
+  };
+
+  void refresh();
+
+  bool open_seat(const std::string& name,
+                 const gebaar::process::session_user& user);
+
+  EventLoop& loop;
+  int inotify_fd = -1;
+  std::map<std::string, seat> seats;
+  std::map<std::string, failed_seat> failed;
+};
+}  // namespace gebaar::io
+
+#endif  // SRC_IO_SEATS_H_
@@ -0,0 +1,106 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SRC_IO_TRACE_H_
+#define SRC_IO_TRACE_H_
+
+#include <cstdint>
+
+#define TRACE_MAGIC 0x54424547  // "GEBT"
+#define TRACE_VERSION 2
+#define TRACE_DEVICE_NAME 64
+
+namespace gebaar::io {
+/*
+ * Record types past the libinput event types, written by the recognizers
+ */
+enum trace_record_type : uint32_t {
+  TRACE_THRESHOLD = 0x10000,  // code: trace_gesture, value: direction
+  TRACE_REJECT,               // code: trace_reject_reason
+  TRACE_GESTURE,              // code: trace_gesture, value: direction,
+                              // x/y: pixels a drag moved the pointer by
+  TRACE_COMMAND,              // code: 1 if spawned, 0 if dropped
+  TRACE_LAG,                  // code: trace_lag_source, value: ms or usec
+  TRACE_MOMENTUM,             // momentum timer tick, replayed like an event
+  TRACE_HOLD_TICK,            // hold timer tick, replayed like an event
+};
+
+enum trace_gesture : int32_t {
+  TRACE_SWIPE = 1,
+  TRACE_PINCH,
+  TRACE_SWITCH,
+  TRACE_HOLD,
+  TRACE_DRAG,
+};
+
+enum trace_lag_source : int32_t {
+  LAG_LIBINPUT = 1,  // libinput reported it is behind, value in ms
+  LAG_HANDLER,       // an event took over the watchdog budget, value in usec
+};
+
+enum trace_reject_reason : int32_t {
+  REJECT_BELOW_THRESHOLD = 1,
+  REJECT_FINGER_COUNT,
+  REJECT_MOTION_SLOTS,
+  REJECT_DIRECTION_MISMATCH,
+  REJECT_SWIPE_COUNT,
+  REJECT_CANCELLED,
+  REJECT_UNTRACKED_SLOT,  // a finger beyond TOUCH_MAX_SLOTS, value: slot
+};
+
+/*
+ * One input event as the recognizers see it, or one recognizer decision.
+ * Fixed size so it can be kept in a ring and written out as is.
+ */
+struct raw_event {
+  uint64_t time;    // usec, CLOCK_MONOTONIC as reported by libinput
+  uint32_t type;    // libinput_event_type or trace_record_type
+  uint32_t device;  // index into the device table
+  int32_t slot;     // touch slot
+  int32_t fingers;
+  int32_t code;   // switch, or decision detail
+  int32_t value;  // switch state, or decision detail
+  double x;       // touch position in mm, or unaccelerated gesture delta
+  double y;
+  double scale;
+  double angle;  // gesture angle delta
+};
+static_assert(sizeof(raw_event) == 64, "raw_event is written to traces");
+
+struct trace_device {
+  char name[TRACE_DEVICE_NAME];
+  double width;  // mm, 0 if unknown
+  double height;
+  uint32_t capabilities;  // bit per libinput_device_capability
+  uint32_t usb_id;        // vendor << 16 | product, 0 if unknown
+};
+
+/*
+ * A trace file is this header, device_count trace_device entries and
+ * record_count raw_event records, oldest first
+ */
+struct trace_header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t device_count;
+  uint64_t record_count;
+};
+}  // namespace gebaar::io
+
+#endif  // SRC_IO_TRACE_H_
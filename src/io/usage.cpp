@@ -0,0 +1,225 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "io/usage.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include "config/config.h"
+#include "io/trace.h"
+
+static_assert(USAGE_DIRECTIONS == MAX_DIRECTION + 1,
+              "every direction needs a binding slot");
+static_assert(gebaar::io::TRACE_DRAG < USAGE_GESTURES,
+              "every gesture needs its bindings");
+static_assert(gebaar::io::REJECT_UNTRACKED_SLOT < USAGE_REJECT_REASONS,
+              "every rejection reason needs a counter");
+
+static const char* const GESTURE_NAMES[USAGE_GESTURES] = {
+    "", "swipe", "pinch", "switch", "hold", "drag"};
+
+static const char* const REJECT_NAMES[USAGE_REJECT_REASONS] = {
+    "",
+    "below threshold",
+    "finger count",
+    "motion slots",
+    "direction mismatch",
+    "swipe count",
+    "cancelled",
+    "untracked slot"};
+
+gebaar::io::UsageStats::~UsageStats() {
+  if (file != nullptr) {
+    munmap(file, sizeof(usage_file));
+  }
+}
+
+/**
+ * Map the statistics file, creating it or starting it over if it doesn't
+ * hold statistics of this version
+ *
+ * @param path file the statistics are kept in
+ * @param writable false to only read them, the file is then left alone
+ * @return bool false if there are no statistics to use
+ */
+bool gebaar::io::UsageStats::open(const std::string& path, bool writable) {
+  int fd = ::open(path.c_str(),
+                  writable ? O_RDWR | O_CREAT | O_CLOEXEC : O_RDONLY | O_CLOEXEC,
+                  0644);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info {};
+  bool resize = fstat(fd, &info) < 0 ||
+                static_cast<size_t>(info.st_size) != sizeof(usage_file);
+  if (resize && (!writable || ftruncate(fd, 0) < 0 ||
+                 ftruncate(fd, sizeof(usage_file)) < 0)) {
+    close(fd);
+    return false;
+  }
+  void* mapped = mmap(nullptr, sizeof(usage_file),
+                      writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                      MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    return false;
+  }
+  file = static_cast<usage_file*>(mapped);
+  this->writable = writable;
+
+  bool valid = file->magic == USAGE_MAGIC && file->version == USAGE_VERSION &&
+               file->size == sizeof(usage_file);
+  if (!valid && !writable) {
+    munmap(file, sizeof(usage_file));
+    file = nullptr;
+    return false;
+  }
+  if (!valid) {
+    memset(file, 0, sizeof(usage_file));
+    file->magic = USAGE_MAGIC;
+    file->version = USAGE_VERSION;
+    file->size = sizeof(usage_file);
+    file->created = time(nullptr);
+  }
+  if (writable) {
+    ++file->starts;
+    file->last_start = time(nullptr);
+  }
+  return true;
+}
+
+/**
+ * Find the slot a command is counted in, taking a free one the first time.
+ * Looked up once per binding, not per run.
+ *
+ * @param text binding as configured
+ * @return usage_command* nullptr if not writable or every slot is taken
+ */
+gebaar::io::usage_command* gebaar::io::UsageStats::command(
+    const std::string& text) {
+  if (file == nullptr || !writable || text.empty()) {
+    return nullptr;
+  }
+  size_t length = std::min<size_t>(text.size(), USAGE_COMMAND_TEXT - 1);
+  uint32_t hash = 2166136261u;  // FNV-1a
+  for (size_t i = 0; i < length; ++i) {
+    hash = (hash ^ static_cast<unsigned char>(text[i])) * 16777619u;
+  }
+  for (size_t probe = 0; probe < USAGE_COMMANDS; ++probe) {
+    usage_command& slot = file->commands[(hash + probe) % USAGE_COMMANDS];
+    if (slot.text[0] == '\0') {
+      memcpy(slot.text, text.data(), length);
+      slot.text[length] = '\0';
+      return &slot;
+    }
+    if (strnlen(slot.text, USAGE_COMMAND_TEXT) == length &&
+        memcmp(slot.text, text.data(), length) == 0) {
+      return &slot;
+    }
+  }
+  return nullptr;
+}
+
+static std::string format_time(int64_t seconds) {
+  char text[32];
+  time_t t = seconds;
+  struct tm local {};
+  localtime_r(&t, &local);
+  strftime(text, sizeof(text), "%Y-%m-%d %H:%M", &local);
+  return text;
+}
+
+static const std::string& direction_name(int gesture, size_t direction) {
+  static const std::string unknown = "?";
+  static const std::string none;
+  if (gesture == gebaar::io::TRACE_DRAG) {
+    return none;
+  }
+  const std::map<size_t, std::string>* names = &SWIPE_COMMANDS;
+  if (gesture == gebaar::io::TRACE_PINCH) {
+    names = &PINCH_COMMANDS;
+  } else if (gesture == gebaar::io::TRACE_SWITCH) {
+    names = &SWITCH_COMMANDS;
+  } else if (gesture == gebaar::io::TRACE_HOLD) {
+    names = &HOLD_COMMANDS;
+  }
+  auto found = names->find(direction);
+  return found != names->end() ? found->second : unknown;
+}
+
+/**
+ * Print what the statistics hold, for gebaard --stats
+ */
+void gebaar::io::UsageStats::summary() const {
+  if (file == nullptr) {
+    return;
+  }
+  printf("Collected since %s, gebaard started %u times, last at %s\n",
+         format_time(file->created).c_str(), file->starts,
+         format_time(file->last_start).c_str());
+
+  printf("\nGestures                                count   avg ms\n");
+  for (int g = 1; g < USAGE_GESTURES; ++g) {
+    for (int f = 0; f < USAGE_FINGERS; ++f) {
+      for (int d = 0; d < USAGE_DIRECTIONS; ++d) {
+        const usage_binding& b = file->bindings[g][f][d];
+        if (b.count == 0) {
+          continue;
+        }
+        std::string fingers =
+            f == 0 ? "" : std::to_string(f) + (f + 1 == USAGE_FINGERS ? "+" : "");
+        printf("  %-7s %-3s %-20s %10llu", GESTURE_NAMES[g], fingers.c_str(),
+               direction_name(g, d).c_str(),
+               static_cast<unsigned long long>(b.count));
+        if (g != TRACE_SWITCH) {
+          printf(" %8llu", static_cast<unsigned long long>(
+                               b.total_duration_usec / b.count / 1000));
+        }
+        printf("\n");
+      }
+    }
+  }
+
+  printf("\nRejected                                count\n");
+  for (int r = 1; r < USAGE_REJECT_REASONS; ++r) {
+    if (file->rejections[r] > 0) {
+      printf("  %-32s %10llu\n", REJECT_NAMES[r],
+             static_cast<unsigned long long>(file->rejections[r]));
+    }
+  }
+
+  printf("\nCommands\n        runs  dropped timeouts   failed   avg ms   max ms\n");
+  for (const auto& c : file->commands) {
+    if (c.text[0] == '\0') {
+      continue;
+    }
+    printf("  %10llu %8llu %8llu %8llu %8llu %8llu  %.*s\n",
+           static_cast<unsigned long long>(c.runs),
+           static_cast<unsigned long long>(c.dropped),
+           static_cast<unsigned long long>(c.timeouts),
+           static_cast<unsigned long long>(c.failures),
+           static_cast<unsigned long long>(
+               c.finished > 0 ? c.total_duration_ms / c.finished : 0),
+           static_cast<unsigned long long>(c.max_duration_ms),
+           USAGE_COMMAND_TEXT, c.text);
+  }
+}
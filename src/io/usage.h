@@ -0,0 +1,118 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SRC_IO_USAGE_H_
+#define SRC_IO_USAGE_H_
+
+#include <cstdint>
+#include <string>
+
+#define USAGE_MAGIC 0x55424547  // "GEBU"
+#define USAGE_VERSION 2
+#define USAGE_GESTURES 6          // indexed by trace_gesture
+#define USAGE_FINGERS 6           // five fingers and more share the last
+#define USAGE_DIRECTIONS 18       // up to MAX_DIRECTION
+#define USAGE_REJECT_REASONS 8    // indexed by trace_reject_reason
+#define USAGE_COMMANDS 64
+#define USAGE_COMMAND_TEXT 104
+
+namespace gebaar::io {
+struct usage_binding {
+  uint64_t count;
+  uint64_t total_duration_usec;  // from the gesture's start to its decision
+};
+
+struct usage_command {
+  char text[USAGE_COMMAND_TEXT];  // binding as configured, truncated
+  uint64_t runs;
+  uint64_t dropped;  // still running from an earlier gesture
+  uint64_t timeouts;
+  uint64_t finished;
+  uint64_t failures;  // non-zero exit status
+  uint64_t total_duration_ms;
+  uint64_t max_duration_ms;
+};
+
+/*
+ * The statistics file, mapped as is. Only fixed size members, a file whose
+ * magic, version or size doesn't match is started over.
+ */
+struct usage_file {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t size;
+  uint32_t starts;  // times gebaard opened it
+  int64_t created;  // wall clock seconds
+  int64_t last_start;
+  uint64_t rejections[USAGE_REJECT_REASONS];
+  usage_binding bindings[USAGE_GESTURES][USAGE_FINGERS][USAGE_DIRECTIONS];
+  usage_command commands[USAGE_COMMANDS];
+};
+
+/*
+ * Gesture usage kept across restarts in a memory mapped file, to tune
+ * defaults from. Counting is a plain store into the shared mapping, the
+ * kernel writes the pages back, so nothing is lost when gebaard crashes.
+ * Does nothing until opened.
+ */
+class UsageStats {
+ public:
+  UsageStats() = default;
+  ~UsageStats();
+
+  UsageStats(const UsageStats&) = delete;
+  UsageStats& operator=(const UsageStats&) = delete;
+
+  bool open(const std::string& path, bool writable);
+
+  /*
+   * Count a recognized gesture
+   * @param gesture trace_gesture
+   * @param fingers fingers it was made with
+   * @param direction direction, pinch or switch state as in the trace
+   * @param duration_usec time since the gesture started
+   */
+  void gesture(int32_t gesture, int32_t fingers, int32_t direction,
+               uint64_t duration_usec) {
+    if (file == nullptr || gesture <= 0 || gesture >= USAGE_GESTURES ||
+        direction < 0 || direction >= USAGE_DIRECTIONS) {
+      return;
+    }
+    fingers = fingers < 0 ? 0 : fingers;
+    fingers = fingers < USAGE_FINGERS ? fingers : USAGE_FINGERS - 1;
+    usage_binding& binding = file->bindings[gesture][fingers][direction];
+    ++binding.count;
+    binding.total_duration_usec += duration_usec;
+  }
+
+  void rejected(int32_t reason) {
+    if (file != nullptr && reason > 0 && reason < USAGE_REJECT_REASONS) {
+      ++file->rejections[reason];
+    }
+  }
+
+  usage_command* command(const std::string& text);
+
+  void summary() const;
+
+ private:
+  usage_file* file = nullptr;
+  bool writable = false;
+};
+}  // namespace gebaar::io
+
+#endif  // SRC_IO_USAGE_H_
@@ -0,0 +1,134 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "log/journald_sink.h"
+#include <endian.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+
+#define JOURNALD_SOCKET "/run/systemd/journal/socket"
+
+static const char* const STRUCTURED_KEYS[][2] = {
+    {"fingers: ", "GEBAAR_FINGERS="},
+    {"type: ", "GEBAAR_TYPE="},
+    {"gesture: ", "GEBAAR_GESTURE="},
+    {"direction: ", "GEBAAR_DIRECTION="}};
+
+/**
+ * Map spdlog levels to syslog priorities
+ */
+static char priority(spdlog::level::level_enum level) {
+  switch (level) {
+    case spdlog::level::critical:
+      return '2';
+    case spdlog::level::err:
+      return '3';
+    case spdlog::level::warn:
+      return '4';
+    case spdlog::level::info:
+      return '6';
+    default:
+      return '7';
+  }
+}
+
+/**
+ * Append a field, using the binary form when the value contains a newline
+ */
+static void append_field(std::string* buffer, const char* key,
+                         const char* value, size_t length) {
+  if (memchr(value, '\n', length) == nullptr) {
+    buffer->append(key);
+    buffer->push_back('=');
+    buffer->append(value, length);
+    buffer->push_back('\n');
+    return;
+  }
+  buffer->append(key);
+  buffer->push_back('\n');
+  uint64_t le_length = htole64(length);
+  buffer->append(reinterpret_cast<const char*>(&le_length),
+                 sizeof(le_length));
+  buffer->append(value, length);
+  buffer->push_back('\n');
+}
+
+gebaar::log::JournaldSink::JournaldSink() {
+  socket_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  struct sockaddr_un addr {};
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, JOURNALD_SOCKET, sizeof(addr.sun_path) - 1);
+  if (socket_fd >= 0 &&
+      connect(socket_fd, reinterpret_cast<struct sockaddr*>(&addr),
+              sizeof(addr)) < 0) {
+    close(socket_fd);
+    socket_fd = -1;
+  }
+  buffer.reserve(512);
+}
+
+gebaar::log::JournaldSink::~JournaldSink() {
+  if (socket_fd >= 0) {
+    close(socket_fd);
+  }
+}
+
+bool gebaar::log::JournaldSink::available() {
+  return access(JOURNALD_SOCKET, W_OK) == 0;
+}
+
+/**
+ * Runs on the logger thread, never on the event loop
+ */
+void gebaar::log::JournaldSink::sink_it_(
+    const spdlog::details::log_msg& msg) {
+  if (socket_fd < 0) {
+    return;
+  }
+  const char* payload = msg.payload.data();
+  size_t length = msg.payload.size();
+
+  buffer.clear();
+  buffer.append("PRIORITY=");
+  buffer.push_back(priority(msg.level));
+  buffer.append("\nSYSLOG_IDENTIFIER=gebaard\n");
+  append_field(&buffer, "MESSAGE", payload, length);
+
+  for (const auto& key : STRUCTURED_KEYS) {
+    size_t key_length = strlen(key[0]);
+    const char* end = payload + length;
+    const char* found = std::search(payload, end, key[0], key[0] + key_length);
+    if (found == end) {
+      continue;
+    }
+    const char* value = found + key_length;
+    const char* value_end = value;
+    while (value_end < end && *value_end != ',' && *value_end != ' ') {
+      ++value_end;
+    }
+    if (value_end > value) {
+      buffer.append(key[1]);
+      buffer.append(value, value_end - value);
+      buffer.push_back('\n');
+    }
+  }
+  send(socket_fd, buffer.data(), buffer.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+}
@@ -0,0 +1,51 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SRC_LOG_JOURNALD_SINK_H_
+#define SRC_LOG_JOURNALD_SINK_H_
+
+#include <spdlog/sinks/base_sink.h>
+#include <mutex>
+#include <string>
+
+namespace gebaar::log {
+/*
+ * Writes entries straight to journald's native socket, without linking
+ * libsystemd. "key: value" pairs for fingers, type, gesture and direction
+ * found in a message are also sent as GEBAAR_* fields, so entries can be
+ * filtered with e.g. journalctl GEBAAR_FINGERS=3.
+ */
+class JournaldSink : public spdlog::sinks::base_sink<std::mutex> {
+ public:
+  JournaldSink();
+  ~JournaldSink() override;
+
+  static bool available();
+
+ protected:
+  void sink_it_(const spdlog::details::log_msg& msg) override;
+
+  void flush_() override {}
+
+ private:
+  int socket_fd;
+  std::string buffer;
+};
+}  // namespace gebaar::log
+
+#endif  // SRC_LOG_JOURNALD_SINK_H_
@@ -0,0 +1,91 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "log/logger.h"
+#include <spdlog/async.h>
+#include <spdlog/sinks/null_sink.h>
+#include <spdlog/sinks/stdout_sinks.h>
+#include <spdlog/spdlog.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include "log/journald_sink.h"
+#include "log/ratelimit_sink.h"
+
+#define LOG_QUEUE_SIZE 1024
+#define LOG_RATELIMIT_BURST 5
+#define LOG_RATELIMIT_INTERVAL 10
+
+static bool stdout_usable() { return fcntl(STDOUT_FILENO, F_GETFL) != -1; }
+
+/**
+ * True when systemd connected stdout to the journal, in which case the native
+ * protocol is preferred so entries keep their structured fields
+ */
+static bool stdout_is_journal() {
+  const char* stream = getenv("JOURNAL_STREAM");
+  struct stat st {};
+  if (stream == nullptr || fstat(STDOUT_FILENO, &st) < 0) {
+    return false;
+  }
+  unsigned long long dev = 0;
+  unsigned long long ino = 0;
+  return sscanf(stream, "%llu:%llu", &dev, &ino) == 2 && dev == st.st_dev &&
+         ino == st.st_ino;
+}
+
+/**
+ * Create the "main" logger. Messages are formatted by the caller and pushed
+ * into a preallocated queue, a background thread writes them out, so
+ * logging never does I/O on the event loop. Must be called after
+ * daemonizing, as the thread would not survive the fork.
+ *
+ * @param daemonized stdout was closed by the daemonizer
+ * @param verbose log debug messages
+ */
+void gebaar::log::setup(bool daemonized, bool verbose) {
+  std::shared_ptr<spdlog::sinks::sink> sink;
+  bool use_stdout = !daemonized && stdout_usable();
+  if ((!use_stdout || stdout_is_journal()) && JournaldSink::available()) {
+    sink = std::make_shared<JournaldSink>();
+  } else if (use_stdout) {
+    sink = std::make_shared<spdlog::sinks::stdout_sink_st>();
+  } else {
+    sink = std::make_shared<spdlog::sinks::null_sink_st>();
+  }
+  auto limited = std::make_shared<RateLimitSink>(
+      sink, LOG_RATELIMIT_BURST, std::chrono::seconds(LOG_RATELIMIT_INTERVAL));
+
+  // The logger thread inherits this mask, so it never takes signals the
+  // event loop reads from signalfds
+  sigset_t all;
+  sigset_t old;
+  sigfillset(&all);
+  pthread_sigmask(SIG_BLOCK, &all, &old);
+  spdlog::init_thread_pool(LOG_QUEUE_SIZE, 1);
+  pthread_sigmask(SIG_SETMASK, &old, nullptr);
+
+  auto logger = std::make_shared<spdlog::async_logger>(
+      "main", limited, spdlog::thread_pool(),
+      spdlog::async_overflow_policy::overrun_oldest);
+  logger->set_level(verbose ? spdlog::level::debug : spdlog::level::info);
+  spdlog::register_logger(logger);
+}
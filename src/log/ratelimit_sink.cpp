@@ -0,0 +1,65 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "log/ratelimit_sink.h"
+#include <functional>
+#include <string>
+#include <string_view>
+
+gebaar::log::RateLimitSink::RateLimitSink(
+    std::shared_ptr<spdlog::sinks::sink> inner, size_t burst,
+    std::chrono::seconds interval)
+    : inner(std::move(inner)), burst(burst), interval(interval) {}
+
+/**
+ * Messages are tracked in a small table indexed by the hash of their text,
+ * a colliding message simply takes over the slot
+ */
+void gebaar::log::RateLimitSink::sink_it_(
+    const spdlog::details::log_msg& msg) {
+  if (msg.level < spdlog::level::info) {
+    inner->log(msg);
+    return;
+  }
+  size_t hash = std::hash<std::string_view>{}(
+      std::string_view(msg.payload.data(), msg.payload.size()));
+  slot& s = slots[hash % RATELIMIT_SLOTS];
+  if (s.hash != hash || msg.time - s.window_start >= interval) {
+    if (s.hash == hash) {
+      report_suppressed(msg, &s);
+    }
+    s.hash = hash;
+    s.window_start = msg.time;
+    s.count = 0;
+  }
+  if (++s.count <= burst) {
+    inner->log(msg);
+  }
+}
+
+void gebaar::log::RateLimitSink::report_suppressed(
+    const spdlog::details::log_msg& msg, slot* s) {
+  if (s->count <= burst) {
+    return;
+  }
+  std::string text = "suppressed " + std::to_string(s->count - burst) +
+                     " repeats of '" +
+                     std::string(msg.payload.data(), msg.payload.size()) + "'";
+  spdlog::details::log_msg summary(msg.logger_name, msg.level, text);
+  inner->log(summary);
+}
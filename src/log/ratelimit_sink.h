@@ -0,0 +1,64 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SRC_LOG_RATELIMIT_SINK_H_
+#define SRC_LOG_RATELIMIT_SINK_H_
+
+#include <spdlog/sinks/base_sink.h>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+#define RATELIMIT_SLOTS 16
+
+namespace gebaar::log {
+/*
+ * Forwards to another sink, but lets an identical message at info level or
+ * above through at most burst times per interval. Touch rejections repeat
+ * on every stray contact and would otherwise flood the journal.
+ */
+class RateLimitSink : public spdlog::sinks::base_sink<std::mutex> {
+ public:
+  RateLimitSink(std::shared_ptr<spdlog::sinks::sink> inner, size_t burst,
+                std::chrono::seconds interval);
+
+ protected:
+  void sink_it_(const spdlog::details::log_msg& msg) override;
+
+  void flush_() override { inner->flush(); }
+
+ private:
+  using clock = spdlog::log_clock;
+
+  struct slot {
+    size_t hash;
+    clock::time_point window_start;
+    size_t count;
+  };
+
+  void report_suppressed(const spdlog::details::log_msg& msg, slot* s);
+
+  std::shared_ptr<spdlog::sinks::sink> inner;
+  size_t burst;
+  std::chrono::seconds interval;
+  std::array<slot, RATELIMIT_SLOTS> slots{};
+};
+}  // namespace gebaar::log
+
+#endif  // SRC_LOG_RATELIMIT_SINK_H_
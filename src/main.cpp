@@ -25,9 +25,15 @@
 #include <cxxopts.hpp>
 #include "config/config.h"
 #include "daemon/daemonizer.h"
+#include "daemon/notify.h"
 #include "io/input.h"
+#include "io/replay.h"
+#include "io/seats.h"
+#include "io/usage.h"
+#include "log/logger.h"
+#include "process/priority.h"
+#include "utils/xdg.h"
 #include "spdlog/fmt/ostr.h"
-#include "spdlog/sinks/stdout_sinks.h"
 
 gebaar::io::Input* input;
 
@@ -38,18 +44,56 @@ std::string get_proc_name() {
   return name;
 }
 
+void raise_latency(int cpu) {
+  auto grant = gebaar::process::raise_priority(cpu);
+  gebaar::process::lock_memory(&grant);
+  spdlog::get("main")->info(
+      "Low latency: {}, CPU {}, memory {}",
+      grant.realtime ? "SCHED_FIFO priority " + std::to_string(grant.priority)
+                     : "nice " + std::to_string(grant.nice),
+      grant.cpu >= 0 ? std::to_string(grant.cpu) : "not pinned",
+      grant.locked ? "locked" : "not locked");
+}
+
+void log_version() {
+  spdlog::get("main")->info("Running {} v{}", get_proc_name(),
+                            std::to_string(GB_VERSION_MAJOR) + "." +
+                                std::to_string(GB_VERSION_MINOR) + "." +
+                                std::to_string(GB_VERSION_RELEASE));
+}
+
 int main(int argc, char* argv[]) {
+  bool should_daemonize = false;
+  bool verbose = false;
+  bool low_latency = false;
+  int cpu = -1;
+  bool system = false;
+  bool show_stats = false;
+  std::string stats_seat = "seat0";
+  std::string replay_path;
+  uint64_t budget = REPLAY_BUDGET_USEC;
   try
   {
-    auto logger = spdlog::stdout_logger_mt("main");
     cxxopts::Options options(argv[0], "Gebaard Gestures Daemon");
 
-    bool should_daemonize = false;
-
     options.add_options()("b,background", "Daemonize",
                           cxxopts::value(should_daemonize))(
         "h,help", "Prints this help text")(
-        "v,verbose", "Prints verbose output during runtime");
+        "v,verbose", "Prints verbose output during runtime")(
+        "l,low-latency", "Run gesture recognition at raised priority",
+        cxxopts::value(low_latency))(
+        "cpu", "CPU to pin to at raised priority, overrides the configuration",
+        cxxopts::value(cpu), "N")(
+        "s,system", "Serve every seat as a system service",
+        cxxopts::value(system))(
+        "replay", "Replay a trace and check the gestures recognized",
+        cxxopts::value(replay_path), "FILE")(
+        "budget", "Processing time allowed for 99% of replayed events in usec",
+        cxxopts::value(budget))(
+        "stats", "Print the gesture usage statistics collected so far",
+        cxxopts::value(show_stats))(
+        "seat", "Seat whose statistics --stats prints, default seat0",
+        cxxopts::value(stats_seat), "SEAT");
 
     auto result = options.parse(argc, argv);
 
@@ -58,9 +102,25 @@ int main(int argc, char* argv[]) {
       exit(EXIT_SUCCESS);
     }
 
+    if (show_stats) {
+      // Seats other than seat0 keep their state in a subdirectory
+      std::string path = gebaar::util::xdg_state_dir();
+      if (stats_seat != "seat0") {
+        path += "/" + stats_seat;
+      }
+      path += "/stats.bin";
+      gebaar::io::UsageStats usage;
+      if (!usage.open(path, false)) {
+        std::cerr << "no statistics in " << path << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      usage.summary();
+      exit(EXIT_SUCCESS);
+    }
+
     if (result.count("verbose")) {
       std::cout << "verbose mode" << std::endl;
-      spdlog::set_level(spdlog::level::debug);
+      verbose = true;
     }
 
     if (should_daemonize) {
@@ -71,17 +131,55 @@ int main(int argc, char* argv[]) {
       std::cerr << "error parsing options: " << e.what() << std::endl;
       exit(EXIT_FAILURE);
   }
+  gebaar::log::setup(should_daemonize, verbose);
+
+  if (system) {
+    // Seats come and go, so there is no configuration to read up front
+    gebaar::io::EventLoop loop;
+    gebaar::io::SeatManager seats(loop);
+    gebaar::daemon::Notifier notifier;
+    if (seats.start()) {
+      log_version();
+      if (low_latency) {
+        // One process serves every seat, a user's configuration can't pick
+        spdlog::get("main")->info(
+            "settings.low_latency of the seats is not used, --cpu picks the "
+            "CPU in system mode");
+        raise_latency(cpu);
+      }
+      notifier.ready(loop, [&seats] { return seats.status(); });
+      loop.run();
+      notifier.stopping();
+    }
+    spdlog::shutdown();
+    return 0;
+  }
 
   auto config = std::make_shared<gebaar::config::Config>();
-  input = new gebaar::io::Input(config);
+  if (!replay_path.empty()) {
+    gebaar::io::Replay replay(config, budget);
+    bool passed = replay.load(replay_path) && replay.run();
+    spdlog::shutdown();
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  gebaar::io::EventLoop loop;
+  auto supervisor = std::make_shared<gebaar::process::Supervisor>(
+      loop, config->settings.command_timeout,
+      config->settings.command_kill_grace);
+  input = new gebaar::io::Input(config, supervisor);
+  gebaar::daemon::Notifier notifier;
 
   if (input->initialize()) {
-    spdlog::get("main")->info("Running {} v{}", get_proc_name(),
-                              std::to_string(GB_VERSION_MAJOR) + "." +
-                                  std::to_string(GB_VERSION_MINOR) + "." +
-                                  std::to_string(GB_VERSION_RELEASE));
-    input->start_loop();
+    log_version();
+    input->attach(loop);
+    if (low_latency || config->settings.low_latency) {
+      raise_latency(cpu >= 0 ? cpu : config->settings.low_latency_cpu);
+    }
+    notifier.ready(loop, [] { return input->status(); });
+    loop.run();
+    notifier.stopping();
   }
 
+  spdlog::shutdown();
   return 0;
 }
@@ -0,0 +1,141 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "process/priority.h"
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <spdlog/spdlog.h>
+#define FN "priority"
+
+// Affinity gebaard started with, handed back to every command it spawns
+static cpu_set_t inherited_cpus;
+static bool pinned = false;
+
+/**
+ * Pick the CPU to pin to, the highest one gebaard may run on unless one was
+ * configured
+ */
+static int choose_cpu(int cpu) {
+  if (cpu >= 0) {
+    return CPU_ISSET(cpu, &inherited_cpus) ? cpu : -1;
+  }
+  for (int i = CPU_SETSIZE - 1; i >= 0; --i) {
+    if (CPU_ISSET(i, &inherited_cpus)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Raise the scheduling priority of the calling thread as far as the
+ * resource limits allow (RLIMIT_RTPRIO and RLIMIT_NICE, as handed out by
+ * pam_limits or rtkit) and pin it to a CPU. SCHED_RESET_ON_FORK makes sure
+ * commands started later run at normal priority again.
+ *
+ * @param cpu CPU to pin to, -1 to pick one
+ * @return latency_grant what was granted
+ */
+gebaar::process::latency_grant gebaar::process::raise_priority(int cpu) {
+  latency_grant grant{};
+  grant.cpu = -1;
+
+  // Without a limit only CAP_SYS_NICE can help, which is worth a try
+  struct rlimit rtprio {};
+  getrlimit(RLIMIT_RTPRIO, &rtprio);
+  int priority = rtprio.rlim_cur > 0 ? std::min<rlim_t>(
+                                           LOW_LATENCY_RT_PRIORITY,
+                                           rtprio.rlim_cur)
+                                     : LOW_LATENCY_RT_PRIORITY;
+  // A runaway real-time thread is sent SIGXCPU instead of starving the CPU
+  struct rlimit rttime {};
+  getrlimit(RLIMIT_RTTIME, &rttime);
+  if (rttime.rlim_cur == RLIM_INFINITY ||
+      rttime.rlim_cur > LOW_LATENCY_RTTIME_USEC) {
+    rttime.rlim_cur = std::min<rlim_t>(LOW_LATENCY_RTTIME_USEC,
+                                       rttime.rlim_max);
+    setrlimit(RLIMIT_RTTIME, &rttime);
+  }
+  struct sched_param param {};
+  param.sched_priority = priority;
+  if (sched_setscheduler(0, SCHED_FIFO | SCHED_RESET_ON_FORK, &param) ==
+      0) {
+    grant.realtime = true;
+    grant.priority = priority;
+  } else {
+    spdlog::get("main")->debug("[{}] at {} - SCHED_FIFO refused: {}", FN,
+                               __LINE__, strerror(errno));
+  }
+
+  if (!grant.realtime) {
+    struct sched_param normal {};
+    sched_setscheduler(0, SCHED_OTHER | SCHED_RESET_ON_FORK, &normal);
+    // RLIMIT_NICE is expressed as 20 - nice
+    struct rlimit nice_limit {};
+    getrlimit(RLIMIT_NICE, &nice_limit);
+    int lowest =
+        20 - static_cast<int>(std::min<rlim_t>(nice_limit.rlim_cur, 40));
+    for (int nice : {LOW_LATENCY_NICE, lowest}) {
+      if (nice < 0 && setpriority(PRIO_PROCESS, 0, nice) == 0) {
+        grant.nice = nice;
+        break;
+      }
+    }
+  }
+
+  if (sched_getaffinity(0, sizeof(inherited_cpus), &inherited_cpus) == 0) {
+    int chosen = choose_cpu(cpu);
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (chosen >= 0) {
+      CPU_SET(chosen, &set);
+    }
+    if (chosen >= 0 && sched_setaffinity(0, sizeof(set), &set) == 0) {
+      grant.cpu = chosen;
+      pinned = true;
+    }
+  }
+  return grant;
+}
+
+/**
+ * Lock the pages gebaard uses now, after everything it needs while running
+ * was set up. Future allocations are not locked, so the RLIMIT_MEMLOCK of
+ * an unprivileged user can't make them fail.
+ */
+void gebaar::process::lock_memory(latency_grant* grant) {
+  grant->locked = mlockall(MCL_CURRENT) == 0;
+  if (!grant->locked) {
+    spdlog::get("main")->debug("[{}] at {} - mlockall refused: {}", FN,
+                               __LINE__, strerror(errno));
+  }
+}
+
+/**
+ * Undo what raise_priority did that a fork inherits. Called in a spawned
+ * child before exec, so only async-signal-safe calls.
+ */
+void gebaar::process::reset_child_scheduling() {
+  if (pinned) {
+    sched_setaffinity(0, sizeof(inherited_cpus), &inherited_cpus);
+  }
+}
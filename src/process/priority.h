@@ -0,0 +1,46 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SRC_PROCESS_PRIORITY_H_
+#define SRC_PROCESS_PRIORITY_H_
+
+#define LOW_LATENCY_RT_PRIORITY 10
+#define LOW_LATENCY_NICE -10
+#define LOW_LATENCY_RTTIME_USEC 200000  // CPU time per real-time burst
+
+namespace gebaar::process {
+/*
+ * What the kernel granted the event thread, realtime false and nice 0 if
+ * nothing could be raised
+ */
+struct latency_grant {
+  bool realtime;
+  int priority;
+  int nice;
+  int cpu;
+  bool locked;
+};
+
+latency_grant raise_priority(int cpu);
+
+void lock_memory(latency_grant* grant);
+
+void reset_child_scheduling();
+}  // namespace gebaar::process
+
+#endif  // SRC_PROCESS_PRIORITY_H_
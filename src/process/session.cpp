@@ -0,0 +1,117 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "process/session.h"
+#include <dirent.h>
+#include <grp.h>
+#include <pwd.h>
+#include <cstdlib>
+#include <fstream>
+
+/**
+ * Seats systemd-logind currently knows about
+ *
+ * @return std::vector<std::string> seat names, e.g. seat0
+ */
+std::vector<std::string> gebaar::process::list_seats() {
+  std::vector<std::string> seats;
+  DIR* dir = opendir(SEATS_DIR);
+  if (dir == nullptr) {
+    return seats;
+  }
+  while (struct dirent* entry = readdir(dir)) {
+    if (entry->d_name[0] != '.') {
+      seats.emplace_back(entry->d_name);
+    }
+  }
+  closedir(dir);
+  return seats;
+}
+
+/**
+ * Read one KEY=value entry of a systemd-logind state file
+ *
+ * @return std::string the value, empty if the file or key is missing
+ */
+std::string gebaar::process::read_state(const std::string& path,
+                                        const std::string& key) {
+  std::ifstream state(path);
+  std::string line;
+  while (std::getline(state, line)) {
+    if (line.size() > key.size() && line[key.size()] == '=' &&
+        line.compare(0, key.size(), key) == 0) {
+      return line.substr(key.size() + 1);
+    }
+  }
+  return "";
+}
+
+/**
+ * Look up the user of the session active on seat
+ *
+ * @param seat seat name
+ * @param user receives the user and the environment its commands get
+ * @return bool false if nobody is logged in on the seat, a login screen
+ * doesn't count
+ */
+bool gebaar::process::active_user(const std::string& seat,
+                                  session_user* user) {
+  std::string seat_path = std::string(SEATS_DIR) + "/" + seat;
+  std::string session = read_state(seat_path, "ACTIVE");
+  std::string uid = read_state(seat_path, "ACTIVE_UID");
+  std::string session_path = std::string(SESSIONS_DIR) + "/" + session;
+  if (session.empty() || uid.empty() ||
+      read_state(session_path, "CLASS") != "user") {
+    return false;
+  }
+  struct passwd* pw = getpwuid(strtoul(uid.c_str(), nullptr, 10));
+  if (pw == nullptr) {
+    return false;
+  }
+  user->uid = pw->pw_uid;
+  user->gid = pw->pw_gid;
+  user->name = pw->pw_name;
+  user->home = pw->pw_dir;
+
+  int count = 32;
+  user->groups.resize(count);
+  if (getgrouplist(pw->pw_name, pw->pw_gid, user->groups.data(), &count) <
+      0) {
+    user->groups.resize(count);
+    getgrouplist(pw->pw_name, pw->pw_gid, user->groups.data(), &count);
+  }
+  user->groups.resize(count);
+
+  std::string runtime_dir = "/run/user/" + uid;
+  user->environment = {
+      "HOME=" + user->home,
+      "USER=" + user->name,
+      "LOGNAME=" + user->name,
+      "SHELL=" + std::string(pw->pw_shell),
+      "PATH=/usr/local/bin:/usr/bin:/bin",
+      "XDG_SEAT=" + seat,
+      "XDG_RUNTIME_DIR=" + runtime_dir,
+      "DBUS_SESSION_BUS_ADDRESS=unix:path=" + runtime_dir + "/bus",
+  };
+  // Only X11 sessions tell logind their display
+  std::string display = read_state(session_path, "DISPLAY");
+  if (!display.empty()) {
+    user->environment.push_back("DISPLAY=" + display);
+  }
+  return true;
+}
@@ -0,0 +1,51 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SRC_PROCESS_SESSION_H_
+#define SRC_PROCESS_SESSION_H_
+
+#include <sys/types.h>
+#include <string>
+#include <vector>
+
+#define SEATS_DIR "/run/systemd/seats"
+#define SESSIONS_DIR "/run/systemd/sessions"
+
+namespace gebaar::process {
+/*
+ * User commands are run as when gebaard serves several seats. Everything a
+ * forked child needs is resolved up front, since it may only make
+ * async-signal-safe calls.
+ */
+struct session_user {
+  uid_t uid;
+  gid_t gid;
+  std::string name;
+  std::string home;
+  std::vector<gid_t> groups;
+  std::vector<std::string> environment;
+};
+
+std::vector<std::string> list_seats();
+
+bool active_user(const std::string& seat, session_user* user);
+
+std::string read_state(const std::string& path, const std::string& key);
+}  // namespace gebaar::process
+
+#endif  // SRC_PROCESS_SESSION_H_
@@ -0,0 +1,287 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "process/supervisor.h"
+#include "process/priority.h"
+#include "utils/probes.h"
+#include <spdlog/spdlog.h>
+#include <sys/signalfd.h>
+#include <grp.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <csignal>
+#define FN "supervisor"
+
+namespace {
+// A SIGCHLD is consumed by whichever signalfd is read first, so with one
+// supervisor per seat any of them reaps for all
+std::vector<gebaar::process::Supervisor*> supervisors;
+// Children of supervisors already destroyed, reaped so they don't linger
+std::vector<pid_t> orphans;
+}  // namespace
+
+/**
+ * Supervisor constructor. SIGCHLD is blocked and read through a signalfd,
+ * so it must be blocked before any other thread is started.
+ *
+ * @param loop event loop the supervisor registers its sources with
+ * @param timeout seconds a command may run before it is terminated, 0 for no
+ * limit
+ * @param kill_grace seconds between SIGTERM and SIGKILL
+ */
+gebaar::process::Supervisor::Supervisor(gebaar::io::EventLoop& loop,
+                                        double timeout, double kill_grace)
+    : loop(loop),
+      timeout(static_cast<int64_t>(timeout * 1000)),
+      kill_grace(static_cast<int64_t>(kill_grace * 1000)) {
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGCHLD);
+  sigprocmask(SIG_BLOCK, &mask, nullptr);
+  signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+  children.reserve(SUPERVISOR_CHILDREN);
+  supervisors.push_back(this);
+
+  loop.watch(signal_fd, [this] {
+    struct signalfd_siginfo info {};
+    while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+    }
+    for (auto* supervisor : supervisors) {
+      supervisor->reap();
+    }
+    for (auto iter = orphans.begin(); iter != orphans.end();) {
+      iter = waitpid(*iter, nullptr, WNOHANG) == *iter ? orphans.erase(iter)
+                                                       : iter + 1;
+    }
+  });
+  loop.watch(timer.fd(), [this] {
+    timer.expirations();
+    enforce_deadlines();
+  });
+}
+
+gebaar::process::Supervisor::~Supervisor() {
+  supervisors.erase(std::find(supervisors.begin(), supervisors.end(), this));
+  for (const auto& c : children) {
+    orphans.push_back(c.pid);
+  }
+  loop.unwatch(signal_fd);
+  loop.unwatch(timer.fd());
+  close(signal_fd);
+}
+
+/**
+ * Start command in a new process group through /bin/sh
+ *
+ * @param binding command as configured, stats are kept and a command only
+ * runs once at a time per binding
+ * @param command_line command line to run, the binding with its placeholders
+ * filled in
+ * @return bool false if the command was not started, either because it is
+ * still running from an earlier gesture or because fork failed
+ */
+bool gebaar::process::Supervisor::spawn(const std::string& binding_name,
+                                        const std::string& command_line) {
+  // Only the first run of a command allocates its entry
+  auto binding = bindings.find(binding_name);
+  if (binding == bindings.end()) {
+    binding = bindings.emplace(binding_name, binding_stats{}).first;
+    if (usage != nullptr) {
+      binding->second.usage = usage->command(binding_name);
+    }
+  }
+  auto& stats = binding->second;
+  if (running(binding_name)) {
+    ++stats.dropped;
+    if (stats.usage != nullptr) {
+      ++stats.usage->dropped;
+    }
+    spdlog::get("main")->debug("[{}] at {} - '{}' still running, dropped", FN,
+                               __LINE__, binding_name);
+    return false;
+  }
+
+  const char* command = command_line.c_str();
+  pid_t pid = fork();
+  if (pid < 0) {
+    spdlog::get("main")->error("[{}] at {} - fork failed for '{}'", FN,
+                               __LINE__, command_line);
+    return false;
+  }
+  if (pid == 0) {
+    // Only async-signal-safe calls from here on
+    setpgid(0, 0);
+    sigset_t empty;
+    sigemptyset(&empty);
+    sigprocmask(SIG_SETMASK, &empty, nullptr);
+    reset_child_scheduling();
+    if (switch_user) {
+      if (setgroups(user.groups.size(), user.groups.data()) < 0 ||
+          setgid(user.gid) < 0 || setuid(user.uid) < 0) {
+        _exit(126);
+      }
+      if (chdir(user.home.c_str()) < 0 && chdir("/") < 0) {
+        _exit(126);
+      }
+      execle("/bin/sh", "sh", "-c", command, static_cast<char*>(nullptr),
+             environment.data());
+    } else {
+      execl("/bin/sh", "sh", "-c", command, static_cast<char*>(nullptr));
+    }
+    _exit(127);
+  }
+  // Also set it from the parent, so a kill can't race the child's setpgid
+  setpgid(pid, pid);
+
+  auto now = clock::now();
+  children.push_back({pid, &binding->first, now,
+                      timeout.count() > 0 ? now + timeout
+                                          : clock::time_point::max(),
+                      false});
+  ++stats.runs;
+  if (stats.usage != nullptr) {
+    ++stats.usage->runs;
+  }
+  GEBAAR_PROBE3(command_spawn, pid, binding->first.c_str(), command);
+  schedule();
+  return true;
+}
+
+/**
+ * Run every command started from now on as the user of a session, with that
+ * user's groups, home directory and a minimal session environment
+ *
+ * @param session user to switch to, gebaard must be running as root
+ */
+void gebaar::process::Supervisor::run_as(const session_user& session) {
+  user = session;
+  environment.clear();
+  for (auto& variable : user.environment) {
+    environment.push_back(&variable[0]);
+  }
+  environment.push_back(nullptr);
+  switch_user = true;
+}
+
+/**
+ * Keep counting commands in persisted statistics as well
+ *
+ * @param stats statistics file, nullptr to stop before it is closed
+ */
+void gebaar::process::Supervisor::record_usage(gebaar::io::UsageStats* stats) {
+  usage = stats;
+  for (auto& binding : bindings) {
+    binding.second.usage =
+        usage != nullptr ? usage->command(binding.first) : nullptr;
+  }
+}
+
+bool gebaar::process::Supervisor::running(const std::string& command) const {
+  for (const auto& c : children) {
+    if (*c.command == command) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Collect every exited child and record its status and runtime
+ */
+void gebaar::process::Supervisor::reap() {
+  // Only wait for our own children, the others belong to other seats
+  for (auto iter = children.begin(); iter != children.end();) {
+    int status = 0;
+    if (waitpid(iter->pid, &status, WNOHANG) != iter->pid) {
+      ++iter;
+      continue;
+    }
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        clock::now() - iter->start)
+                        .count();
+    auto& stats = bindings[*iter->command];
+    stats.last_status = WIFEXITED(status) ? WEXITSTATUS(status)
+                                          : 128 + WTERMSIG(status);
+    stats.last_duration_ms = duration;
+    stats.total_duration_ms += duration;
+    if (stats.usage != nullptr) {
+      ++stats.usage->finished;
+      stats.usage->failures += stats.last_status != 0 ? 1 : 0;
+      stats.usage->total_duration_ms += duration;
+      stats.usage->max_duration_ms =
+          std::max<uint64_t>(stats.usage->max_duration_ms, duration);
+    }
+    if (stats.last_status != 0) {
+      spdlog::get("main")->warn("{} -> Non-zero exit code: {}",
+                                *iter->command, stats.last_status);
+    }
+    spdlog::get("main")->debug("[{}] at {} - '{}' finished in {} ms", FN,
+                               __LINE__, *iter->command, duration);
+    GEBAAR_PROBE3(command_exit, iter->pid, stats.last_status, duration);
+    iter = children.erase(iter);
+  }
+  schedule();
+}
+
+/**
+ * Send SIGTERM to the process group of every command past its timeout, and
+ * SIGKILL to those still alive kill_grace later
+ */
+void gebaar::process::Supervisor::enforce_deadlines() {
+  auto now = clock::now();
+  for (auto& c : children) {
+    if (c.deadline > now) {
+      continue;
+    }
+    if (!c.terminated) {
+      spdlog::get("main")->warn("'{}' timed out after {} ms, terminating",
+                                *c.command, timeout.count());
+      auto& stats = bindings[*c.command];
+      ++stats.timeouts;
+      if (stats.usage != nullptr) {
+        ++stats.usage->timeouts;
+      }
+      kill(-c.pid, SIGTERM);
+      c.terminated = true;
+    } else {
+      spdlog::get("main")->warn("'{}' ignored SIGTERM, killing", *c.command);
+      kill(-c.pid, SIGKILL);
+    }
+    c.deadline = now + kill_grace;
+  }
+  schedule();
+}
+
+/**
+ * Arm the timer for the nearest deadline
+ */
+void gebaar::process::Supervisor::schedule() {
+  auto next = clock::time_point::max();
+  for (const auto& c : children) {
+    next = std::min(next, c.deadline);
+  }
+  if (next == clock::time_point::max()) {
+    timer.disarm();
+    return;
+  }
+  auto delay =
+      std::chrono::duration_cast<std::chrono::milliseconds>(next - clock::now())
+          .count();
+  timer.arm(delay > 0 ? delay : 0);
+}
@@ -0,0 +1,104 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SRC_PROCESS_SUPERVISOR_H_
+#define SRC_PROCESS_SUPERVISOR_H_
+
+#include <sys/types.h>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "io/loop.h"
+#include "io/usage.h"
+#include "process/session.h"
+
+#define SUPERVISOR_CHILDREN 16  // running commands before children grows
+
+namespace gebaar::process {
+struct binding_stats {
+  uint64_t runs;
+  uint64_t dropped;
+  uint64_t timeouts;
+  int last_status;
+  uint64_t last_duration_ms;
+  uint64_t total_duration_ms;
+  gebaar::io::usage_command* usage;  // persisted counters, may be nullptr
+};
+
+/*
+ * Runs configured commands without blocking the event loop. Each command
+ * gets its own process group so a hung command and everything it started
+ * can be terminated together, and exit status and runtime are recorded per
+ * command.
+ */
+class Supervisor {
+ public:
+  Supervisor(gebaar::io::EventLoop& loop, double timeout, double kill_grace);
+  ~Supervisor();
+
+  Supervisor(const Supervisor&) = delete;
+  Supervisor& operator=(const Supervisor&) = delete;
+
+  bool spawn(const std::string& command) { return spawn(command, command); }
+
+  bool spawn(const std::string& binding_name, const std::string& command_line);
+
+  bool running(const std::string& command) const;
+
+  void run_as(const session_user& session);
+
+  void record_usage(gebaar::io::UsageStats* stats);
+
+  const std::map<std::string, binding_stats>& stats() const {
+    return bindings;
+  }
+
+ private:
+  using clock = std::chrono::steady_clock;
+
+  struct child {
+    pid_t pid;
+    const std::string* command;  // key in bindings, nodes never move
+    clock::time_point start;
+    clock::time_point deadline;
+    bool terminated;
+  };
+
+  void reap();
+
+  void enforce_deadlines();
+
+  void schedule();
+
+  gebaar::io::EventLoop& loop;
+  gebaar::io::Timer timer;
+  int signal_fd;
+  std::chrono::milliseconds timeout;
+  std::chrono::milliseconds kill_grace;
+  std::vector<child> children;
+  std::map<std::string, binding_stats> bindings;
+  gebaar::io::UsageStats* usage = nullptr;
+  bool switch_user = false;
+  session_user user;
+  std::vector<char*> environment;  // points into user.environment
+};
+}  // namespace gebaar::process
+
+#endif  // SRC_PROCESS_SUPERVISOR_H_
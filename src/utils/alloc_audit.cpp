@@ -0,0 +1,67 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "utils/alloc_audit.h"
+#include <cstdlib>
+#include <new>
+
+#ifdef GEBAAR_ALLOC_AUDIT
+// Per thread so the logger's worker thread doesn't show up in the count
+static thread_local uint64_t allocations = 0;
+
+static void* counted_alloc(std::size_t size) {
+  ++allocations;
+  return malloc(size == 0 ? 1 : size);
+}
+
+void* operator new(std::size_t size) {
+  void* ptr = counted_alloc(size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void* operator new[](std::size_t size) {
+  void* ptr = counted_alloc(size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return counted_alloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return counted_alloc(size);
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+
+void operator delete[](void* ptr) noexcept { free(ptr); }
+
+void operator delete(void* ptr, std::size_t) noexcept { free(ptr); }
+
+void operator delete[](void* ptr, std::size_t) noexcept { free(ptr); }
+
+uint64_t gebaar::util::thread_allocations() { return allocations; }
+#else
+uint64_t gebaar::util::thread_allocations() { return 0; }
+#endif
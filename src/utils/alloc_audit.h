@@ -0,0 +1,32 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SRC_UTILS_ALLOC_AUDIT_H_
+#define SRC_UTILS_ALLOC_AUDIT_H_
+
+#include <cstdint>
+
+namespace gebaar::util {
+/*
+ * Number of operator new calls made by the calling thread. Only counted in
+ * builds configured with -DGEBAAR_ALLOC_AUDIT=ON, always 0 otherwise.
+ */
+uint64_t thread_allocations();
+}  // namespace gebaar::util
+
+#endif  // SRC_UTILS_ALLOC_AUDIT_H_
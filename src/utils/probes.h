@@ -0,0 +1,49 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SRC_UTILS_PROBES_H_
+#define SRC_UTILS_PROBES_H_
+
+/*
+ * USDT probes under the "gebaard" provider, for tracing a release build with
+ * bpftrace or perf. A probe is a single nop until a tracer attaches to it.
+ * Builds without <sys/sdt.h> or configured with -DGEBAAR_USDT=OFF get no
+ * probes at all. Arguments must be integers or pointers.
+ */
+#if defined(GEBAAR_USDT) && __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define GEBAAR_PROBE3(name, a, b, c) DTRACE_PROBE3(gebaard, name, a, b, c)
+#define GEBAAR_PROBE4(name, a, b, c, d) \
+  DTRACE_PROBE4(gebaard, name, a, b, c, d)
+#else
+#define GEBAAR_PROBE3(name, a, b, c) \
+  do {                               \
+    (void)(a);                       \
+    (void)(b);                       \
+    (void)(c);                       \
+  } while (0)
+#define GEBAAR_PROBE4(name, a, b, c, d) \
+  do {                                  \
+    (void)(a);                          \
+    (void)(b);                          \
+    (void)(c);                          \
+    (void)(d);                          \
+  } while (0)
+#endif
+
+#endif  // SRC_UTILS_PROBES_H_
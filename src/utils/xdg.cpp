@@ -0,0 +1,76 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "utils/xdg.h"
+#include <pwd.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <system_error>
+#include "utils/filesystem.h"
+#include "utils/string-from-char.h"
+
+/**
+ * Directory for state gebaard keeps between runs, according to XDG spec.
+ * Created if it doesn't exist yet. A system service gets the one systemd
+ * created for it.
+ *
+ * @return $XDG_STATE_HOME/gebaar, or an empty string if no home was found
+ */
+std::string gebaar::util::xdg_state_dir() {
+  std::string path = stringFromCharArray(getenv("STATE_DIRECTORY"));
+  if (!path.empty()) {
+    // systemd passes a colon separated list when several are configured
+    return path.substr(0, path.find(':'));
+  }
+  path = stringFromCharArray(getenv("XDG_STATE_HOME"));
+  if (path.empty()) {
+    path = stringFromCharArray(getenv("HOME"));
+    if (path.empty()) {
+      struct passwd* pw = getpwuid(getuid());
+      path = pw != nullptr ? pw->pw_dir : "";
+    }
+    if (path.empty()) {
+      return "";
+    }
+    path.append("/.local/state");
+  }
+  path.append("/gebaar");
+  std::error_code error;
+  std::filesystem::create_directories(path, error);
+  return path;
+}
+
+/**
+ * Private directory for files that don't outlive the session, e.g. traces.
+ * A system service gets the one systemd created for it. Never a shared
+ * directory like /tmp, where names can be taken over with a symlink.
+ *
+ * @return $RUNTIME_DIRECTORY, $XDG_RUNTIME_DIR or the state directory, empty
+ * if there is none of them
+ */
+std::string gebaar::util::xdg_runtime_dir() {
+  std::string path = stringFromCharArray(getenv("RUNTIME_DIRECTORY"));
+  if (!path.empty()) {
+    return path.substr(0, path.find(':'));
+  }
+  path = stringFromCharArray(getenv("XDG_RUNTIME_DIR"));
+  if (!path.empty()) {
+    return path;
+  }
+  return xdg_state_dir();
+}
@@ -0,0 +1,494 @@
+#!/usr/bin/env python3
+"""Writes the traces under test/traces that gebaard_regress replays.
+
+Each directory there holds a gebaard.toml and traces of gestures made with
+it, along with the gestures they must be recognized as. The traces are
+synthesized rather than recorded, so every gesture is easy to follow. The
+jitter scenarios add what recorded sessions have: uneven frame timing and
+motion, fingers added mid swipe, swipes next to sector boundaries. Their
+noise is seeded, so the traces only change with the scenario. Run this
+again after changing a scenario and commit the traces it writes.
+
+The format is the one of src/io/trace.h.
+"""
+
+import math
+import os
+import random
+import struct
+
+TRACE_MAGIC = 0x54424547
+TRACE_VERSION = 2
+
+# libinput_event_type
+TOUCH_DOWN, TOUCH_UP, TOUCH_MOTION, TOUCH_CANCEL, TOUCH_FRAME = range(500, 505)
+SWIPE_BEGIN, SWIPE_UPDATE, SWIPE_END = 800, 801, 802
+PINCH_BEGIN, PINCH_UPDATE, PINCH_END = 803, 804, 805
+SWITCH_TOGGLE = 900
+
+# Bits of libinput_device_capability
+CAP_TOUCH = 1 << 2
+CAP_GESTURE = 1 << 5
+CAP_SWITCH = 1 << 6
+
+# trace_record_type and trace_gesture
+TRACE_GESTURE = 0x10002
+TRACE_HOLD_TICK = 0x10006
+SWIPE, PINCH, SWITCH, HOLD, DRAG = range(1, 6)
+
+# Directions, see SWIPE_COMMANDS and PINCH_COMMANDS
+RIGHT_UP, UP, LEFT, RIGHT, DOWN, RIGHT_DOWN = 3, 2, 4, 6, 8, 9
+PINCH_IN, PINCH_OUT, ROTATE_LEFT, ROTATE_RIGHT = 1, 2, 3, 4
+LAPTOP, TABLET = 0, 1
+
+FRAME_USEC = 7000
+PAUSE_USEC = 200000
+
+TOUCHPAD = ("Synthetic Touchpad", 100.0, 60.0, CAP_GESTURE)
+TOUCHSCREEN = ("Synthetic Touchscreen", 300.0, 200.0, CAP_TOUCH)
+TABLET_SWITCH = ("Synthetic Tablet Mode Switch", 0.0, 0.0, CAP_SWITCH)
+
+
+class Trace:
+    """Events of one trace, with the gestures they must be recognized as"""
+
+    def __init__(self, *devices):
+        self.devices = devices
+        self.records = []
+        self.time = 1000000
+
+    def event(self, type, device=0, slot=-1, fingers=0, code=0, value=0,
+              x=0.0, y=0.0, scale=0.0, angle=0.0):
+        self.records.append((self.time, type, device, slot, fingers, code,
+                             value, x, y, scale, angle))
+
+    def wait(self, usec=FRAME_USEC):
+        self.time += usec
+
+    def expect(self, gesture, direction, fingers, x=0.0, y=0.0):
+        """A gesture the last event completes"""
+        self.event(TRACE_GESTURE, code=gesture, value=direction,
+                   fingers=fingers, x=x, y=y)
+
+    def swipe(self, fingers, dx, dy, updates, expect=None, at=None):
+        """A touchpad swipe moving by the same delta on every update
+
+        expect: (gesture, direction) recognized on update number at, or on
+        the swipe's end if at is None
+        """
+        self.event(SWIPE_BEGIN, fingers=fingers)
+        for update in range(1, updates + 1):
+            self.wait()
+            self.event(SWIPE_UPDATE, fingers=fingers, x=dx, y=dy)
+            if expect and update == at:
+                self.expect(*expect, fingers)
+        self.wait()
+        self.event(SWIPE_END, fingers=fingers)
+        if expect and at is None:
+            self.expect(*expect, fingers)
+        self.wait(PAUSE_USEC)
+
+    def drag(self, fingers, dx, dy, updates, moved):
+        """A touchpad swipe with settings.swipe.drag_fingers
+
+        moved: (x, y) pixels the pointer must be moved by, what is left
+        below a pixel is dropped at the end
+        """
+        self.event(SWIPE_BEGIN, fingers=fingers)
+        for _ in range(updates):
+            self.wait()
+            self.event(SWIPE_UPDATE, fingers=fingers, x=dx, y=dy)
+        self.wait()
+        self.event(SWIPE_END, fingers=fingers)
+        self.expect(DRAG, 0, fingers, *moved)
+        self.wait(PAUSE_USEC)
+
+    def pinch(self, updates, expect, at):
+        """A two finger touchpad pinch
+
+        updates: (scale since the begin, angle delta) of each update
+        expect: (gesture, direction) recognized on update number at
+        """
+        self.event(PINCH_BEGIN, fingers=2, scale=1.0)
+        for update, (scale, angle) in enumerate(updates, 1):
+            self.wait()
+            self.event(PINCH_UPDATE, fingers=2, scale=scale, angle=angle)
+            if update == at:
+                self.expect(*expect, 2)
+        self.wait()
+        self.event(PINCH_END, fingers=2, scale=updates[-1][0])
+        self.wait(PAUSE_USEC)
+
+    def touch_down(self, points, first_slot=0):
+        """Fingers touching down 10 ms apart, a frame each"""
+        for slot, (x, y) in enumerate(points, first_slot):
+            self.event(TOUCH_DOWN, slot=slot, x=x, y=y)
+            self.event(TOUCH_FRAME)
+            self.wait(10000)
+
+    def touch_move(self, points, deltas, frames, first_slot=0):
+        """Frames moving each finger by its delta, returns where they end up.
+        The first frame a finger moves in is where its swipe starts from."""
+        points = list(points)
+        for _ in range(frames):
+            for finger, (dx, dy) in enumerate(deltas):
+                x, y = points[finger]
+                points[finger] = (x + dx, y + dy)
+                self.event(TOUCH_MOTION, slot=first_slot + finger,
+                           x=x + dx, y=y + dy)
+            self.event(TOUCH_FRAME)
+            self.wait()
+        return points
+
+    def touch_up(self, fingers, first_slot=0):
+        """Every finger lifting in one frame"""
+        for slot in range(first_slot, first_slot + fingers):
+            self.event(TOUCH_UP, slot=slot)
+        self.event(TOUCH_FRAME)
+
+    def touch_swipe(self, points, deltas, frames, expect=None, first_slot=0):
+        """expect: (gesture, direction) recognized when the fingers lift"""
+        self.touch_down(points, first_slot)
+        self.touch_move(points, deltas, frames, first_slot)
+        self.touch_up(len(points), first_slot)
+        if expect:
+            self.expect(*expect, len(points))
+        self.wait(PAUSE_USEC)
+
+    def write(self, path):
+        with open(path, "wb") as out:
+            out.write(struct.pack("<IIIIQ", TRACE_MAGIC, TRACE_VERSION, 64,
+                                  len(self.devices), len(self.records)))
+            for name, width, height, capabilities in self.devices:
+                out.write(struct.pack("<64sddII", name.encode(), width,
+                                      height, capabilities, 0))
+            for record in self.records:
+                out.write(struct.pack("<QIIiiiidddd", *record))
+
+
+# Touchpad swipes cross the 500 x 250 unit threshold on the update after the
+# one that reaches it, one shot. Swipes that don't get there run on release.
+
+
+def swipe_cardinal():
+    t = Trace(TOUCHPAD, TABLET_SWITCH)
+    t.swipe(3, 100.0, 0.0, 8, (SWIPE, RIGHT), at=6)
+    t.swipe(4, 0.0, -60.0, 6, (SWIPE, UP), at=5)
+    t.swipe(3, -50.0, 0.0, 2, (SWIPE, LEFT))
+    t.event(SWITCH_TOGGLE, device=1, code=2, value=1)
+    t.expect(SWITCH, TABLET, 0)
+    return t
+
+
+def swipe_diagonal():
+    t = Trace(TOUCHPAD, TABLET_SWITCH)
+    t.swipe(3, 0.0, 50.0, 7, (SWIPE, DOWN), at=6)
+    t.swipe(4, -120.0, 0.0, 6, (SWIPE, LEFT), at=5)
+    t.swipe(3, 80.0, 40.0, 8, (SWIPE, RIGHT_DOWN), at=7)
+    t.swipe(3, 0.0, -40.0, 2, (SWIPE, UP))
+    t.event(SWITCH_TOGGLE, device=1, code=2, value=0)
+    t.expect(SWITCH, LAPTOP, 0)
+    return t
+
+
+def swipe_first_step():
+    # Starting a little up, then right. The swipe only steps once it covers
+    # the threshold, on the seventh update, so it is a swipe right.
+    t = Trace(TOUCHPAD)
+    t.event(SWIPE_BEGIN, fingers=3)
+    t.wait()
+    t.event(SWIPE_UPDATE, fingers=3, y=-40.0)
+    for _ in range(6):
+        t.wait()
+        t.event(SWIPE_UPDATE, fingers=3, x=100.0)
+    t.expect(SWIPE, RIGHT, 3)
+    t.wait()
+    t.event(SWIPE_END, fingers=3)
+    t.wait(PAUSE_USEC)
+    return t
+
+
+# Continuous swipes step again each time they cover the threshold anew, with
+# the fingers they started with
+
+
+def continuous_steps():
+    t = Trace(TOUCHPAD)
+    t.event(SWIPE_BEGIN, fingers=3)
+    for update in range(1, 14):
+        t.wait()
+        t.event(SWIPE_UPDATE, fingers=3, x=100.0)
+        if update in (6, 12):
+            t.expect(SWIPE, RIGHT, 3)
+    t.wait()
+    t.event(SWIPE_END, fingers=3)
+    t.wait(PAUSE_USEC)
+    return t
+
+
+# The four finger command renders longer than the room kept for it. The
+# first swipe warms up, the second one allocates and must fail the replay of
+# a gebaard built with GEBAAR_ALLOC_AUDIT.
+
+
+def alloc_gate_long_command():
+    t = Trace(TOUCHPAD)
+    t.swipe(3, 100.0, 0.0, 8, (SWIPE, RIGHT), at=6)
+    t.swipe(4, 0.0, -60.0, 6, (SWIPE, UP), at=5)
+    return t
+
+
+# Short touchpad swipes, run on release, with left and right 90 degrees wide
+# and 30 for the other sectors
+
+
+def sector_widths_wide_horizontal():
+    t = Trace(TOUCHPAD)
+    for angle, direction in ((40, RIGHT), (50, RIGHT_UP), (80, UP),
+                             (-40, RIGHT), (-70, RIGHT_DOWN)):
+        radians = math.radians(angle)
+        t.swipe(3, 50.0 * math.cos(radians), -50.0 * math.sin(radians), 2,
+                (SWIPE, direction))
+    t.swipe(3, -50.0, -40.0, 2, (SWIPE, LEFT))
+    return t
+
+
+# Touchpad swipes of uneven speed and timing with 16 sectors, 22.5 degrees
+# each. Each swipe keeps one angle, 1.5 degrees to either side of a sector
+# boundary, so its direction doesn't depend on the update it triggers on.
+
+SECTOR_BOUNDARIES = (11.25, 33.75, 56.25, 78.75)
+
+
+def classify16(angle, left, up):
+    """Direction of a swipe at angle degrees from the horizontal in the
+    quadrant given, as DirectionClassifier numbers it"""
+    crossed = sum(angle >= boundary for boundary in SECTOR_BOUNDARIES)
+    horizontal = 4 if left else 6
+    vertical = 2 if up else 8
+    diagonal = 5 + (-1 if left else 1) + (-3 if up else 3)
+    between_horizontal = 12 + (0 if up else 2) + (0 if left else 1)
+    between_vertical = 10 + (0 if up else 6) + (0 if left else 1)
+    return (horizontal, between_horizontal, diagonal, between_vertical,
+            vertical)[crossed]
+
+
+def jittered_swipe(t, rng, fingers, angle, left, up, updates):
+    dx = math.cos(math.radians(angle)) * (-1 if left else 1)
+    dy = math.sin(math.radians(angle)) * (-1 if up else 1)
+    t.event(SWIPE_BEGIN, fingers=fingers)
+    for _ in range(updates):
+        t.wait(rng.randint(5000, 11000))
+        speed = rng.uniform(40.0, 90.0)
+        t.event(SWIPE_UPDATE, fingers=fingers, x=dx * speed, y=dy * speed)
+    t.wait(rng.randint(5000, 11000))
+    t.event(SWIPE_END, fingers=fingers)
+
+
+def touchpad_jitter_session():
+    rng = random.Random(35)
+    t = Trace(TOUCHPAD)
+    for index, boundary in enumerate(SECTOR_BOUNDARIES * 2):
+        # Every boundary in two quadrants, mirrored vertically
+        left, up = index & 1, (index >> 1 ^ index >> 2) & 1
+        for angle in (boundary - 1.5, boundary + 1.5):
+            jittered_swipe(t, rng, 3, angle, left, up, rng.randint(6, 9))
+            # One shot, on the update past the threshold or on release
+            t.expect(SWIPE, classify16(angle, left, up), 3)
+            t.wait(rng.randint(150000, 400000))
+    # A fourth finger joining ends libinput's three finger swipe, short of
+    # the threshold so it runs on release, and starts a four finger one
+    jittered_swipe(t, rng, 3, 4.0, False, False, 2)
+    t.expect(SWIPE, RIGHT, 3)
+    jittered_swipe(t, rng, 4, 3.0, False, False, 7)
+    t.expect(SWIPE, RIGHT, 4)
+    return t
+
+
+# Touchscreen swipes of uneven speed and timing. The fingers of a gesture
+# move together, so they keep their distance and make no pinch.
+
+
+def jittered_touch_swipe(t, rng, points, delta, spread, frames):
+    for slot, (x, y) in enumerate(points):
+        t.event(TOUCH_DOWN, slot=slot, x=x, y=y)
+        t.event(TOUCH_FRAME)
+        t.wait(rng.randint(6000, 15000))
+    for _ in range(frames):
+        step = (delta[0] + rng.uniform(-spread, spread),
+                delta[1] + rng.uniform(-spread, spread))
+        points = [(x + step[0], y + step[1]) for x, y in points]
+        for slot, (x, y) in enumerate(points):
+            t.event(TOUCH_MOTION, slot=slot, x=x, y=y)
+        t.event(TOUCH_FRAME)
+        t.wait(rng.randint(5000, 12000))
+    t.touch_up(len(points))
+
+
+def touchscreen_jitter_session():
+    rng = random.Random(35)
+    t = Trace(TOUCHSCREEN)
+    # At most 2 mm across 16 to 20 mm a frame, a few degrees off
+    jittered_touch_swipe(t, rng, [(40.0, 90.0), (40.0, 130.0)],
+                         (18.0, 0.0), 2.0, 12)
+    t.expect(SWIPE, RIGHT, 2)
+    t.wait(rng.randint(150000, 400000))
+    # 10 frames after the first one of 15 to 17.5 mm cover the 140 mm
+    jittered_touch_swipe(t, rng, [(150.0, 5.0)], (0.5, 16.25), 1.25, 11)
+    t.expect(SWIPE, DOWN, 1)
+    t.wait(rng.randint(150000, 400000))
+    jittered_touch_swipe(t, rng, [(240.0, 60.0), (240.0, 90.0),
+                                  (240.0, 120.0)], (-12.0, 0.0), 2.0, 11)
+    t.expect(SWIPE, LEFT, 3)
+    t.wait(rng.randint(150000, 400000))
+    # No more than 100 mm, short of 140 mm
+    jittered_touch_swipe(t, rng, [(150.0, 180.0)], (0.0, -9.0), 1.0, 11)
+    t.wait(PAUSE_USEC)
+    return t
+
+
+# Three finger swipes drag at speed 1, four finger ones still swipe
+
+
+def drag_carry():
+    t = Trace(TOUCHPAD)
+    # -32.5 pixels up, the half pixel never reaches the pointer
+    t.drag(3, 10.5, -3.25, 10, (105, -32))
+    t.swipe(4, 100.0, 0.0, 7, (SWIPE, RIGHT), at=6)
+    return t
+
+
+def drag_short():
+    t = Trace(TOUCHPAD)
+    t.drag(3, -7.75, 12.5, 12, (-93, 150))
+    t.drag(3, 0.25, 0.25, 3, (0, 0))
+    return t
+
+
+# Pinches settle what they are on their third update, then trigger once past
+# 0.25 of scale or 20 degrees
+
+
+def pinch_out_rotate_right():
+    t = Trace(TOUCHPAD)
+    t.pinch([(1.05, 0), (1.10, 0), (1.15, 0), (1.20, 0), (1.30, 0),
+             (1.40, 0)], (PINCH, PINCH_OUT), at=5)
+    t.pinch([(1.0, 5.0)] * 6, (PINCH, ROTATE_RIGHT), at=5)
+    return t
+
+
+def pinch_in_rotate_left():
+    # A one shot pinch in compares the scale of the update before
+    t = Trace(TOUCHPAD)
+    t.pinch([(0.95, 0), (0.90, 0), (0.85, 0), (0.80, 0), (0.72, 0),
+             (0.70, 0), (0.65, 0)], (PINCH, PINCH_IN), at=6)
+    t.pinch([(1.0, -6.0)] * 5, (PINCH, ROTATE_LEFT), at=4)
+    return t
+
+
+def pinch_rotate_left_fraction():
+    # Past 20 degrees by half a degree only, which truncating the angle to
+    # whole degrees would miss
+    t = Trace(TOUCHPAD)
+    t.pinch([(1.0, -5.0)] * 4 + [(1.0, -0.5)], (PINCH, ROTATE_LEFT), at=5)
+    return t
+
+
+# The touchscreen is 300 x 200 mm, a one finger swipe must cover 70% of it
+
+
+def touch_two_and_one_finger():
+    t = Trace(TOUCHSCREEN)
+    t.touch_swipe([(100.0, 100.0), (150.0, 100.0)], [(20.0, 0.0)] * 2, 11,
+                  (SWIPE, RIGHT))
+    t.touch_swipe([(150.0, 20.0)], [(0.0, 15.0)], 11, (SWIPE, DOWN))
+    # Slot 11 is not tracked, the gesture is rejected
+    t.touch_swipe([(100.0, 100.0)], [(0.0, 20.0)], 11, first_slot=11)
+    # Fingers 60 mm apart closing in 4 mm a frame while swiping. The pinch
+    # in has no command, so the swipe still runs once they lift.
+    points = [(100.0, 100.0), (160.0, 100.0)]
+    deltas = [(22.0, 0.0), (18.0, 0.0)]
+    t.touch_down(points)
+    points = t.touch_move(points, deltas, 5)
+    t.expect(PINCH, PINCH_IN, 2)  # one shot, then continuous
+    t.expect(PINCH, PINCH_IN, 2)
+    t.touch_move(points, deltas, 6)
+    t.touch_up(2)
+    t.expect(SWIPE, RIGHT, 2)
+    return t
+
+
+def touch_three_fingers_and_pinch():
+    t = Trace(TOUCHSCREEN)
+    t.touch_swipe([(200.0, 80.0), (200.0, 110.0), (200.0, 140.0)],
+                  [(-12.0, 0.0)] * 3, 11, (SWIPE, LEFT))
+    # 100 mm is short of 140 mm
+    t.touch_swipe([(150.0, 180.0)], [(0.0, -10.0)], 11)
+    # Fingers 50 mm apart spreading 10 mm a frame, 1.4 times apart on the
+    # second frame
+    t.touch_down([(125.0, 100.0), (175.0, 100.0)])
+    t.touch_move([(125.0, 100.0), (175.0, 100.0)],
+                 [(-5.0, 0.0), (5.0, 0.0)], 1)
+    t.touch_move([(120.0, 100.0), (180.0, 100.0)],
+                 [(-5.0, 0.0), (5.0, 0.0)], 1)
+    t.expect(PINCH, PINCH_OUT, 2)
+    t.touch_move([(115.0, 100.0), (185.0, 100.0)],
+                 [(-5.0, 0.0), (5.0, 0.0)], 4)
+    t.touch_up(2)
+    return t
+
+
+# A finger resting for 300 ms runs the hold command once, from a timer tick
+
+
+def hold(t, points, fingers):
+    t.touch_down(points)
+    t.wait(300000 - 10000 * len(points))
+    t.event(TRACE_HOLD_TICK, fingers=fingers)
+    t.expect(HOLD, 1, fingers)
+    t.wait(100000)
+    t.touch_up(len(points))
+    t.wait(PAUSE_USEC)
+
+
+def hold_one_finger():
+    t = Trace(TOUCHSCREEN)
+    hold(t, [(150.0, 100.0)], 1)
+    # Moving more than 3 mm ends the hold before it runs
+    t.touch_swipe([(150.0, 20.0)], [(0.0, 15.0)], 11, (SWIPE, DOWN))
+    return t
+
+
+def hold_two_fingers():
+    t = Trace(TOUCHSCREEN)
+    hold(t, [(120.0, 100.0), (170.0, 100.0)], 2)
+    t.touch_swipe([(120.0, 150.0), (170.0, 150.0)], [(0.0, -15.0)] * 2, 11,
+                  (SWIPE, UP))
+    return t
+
+
+TRACES = {
+    "swipe/cardinal.trace": swipe_cardinal,
+    "swipe/diagonal.trace": swipe_diagonal,
+    "swipe/first-step.trace": swipe_first_step,
+    "continuous/steps.trace": continuous_steps,
+    "alloc-gate/long-command.trace": alloc_gate_long_command,
+    "sector-widths/wide-horizontal.trace": sector_widths_wide_horizontal,
+    "drag/carry.trace": drag_carry,
+    "drag/short.trace": drag_short,
+    "pinch/in-rotate-left.trace": pinch_in_rotate_left,
+    "pinch/out-rotate-right.trace": pinch_out_rotate_right,
+    "pinch/rotate-left-fraction.trace": pinch_rotate_left_fraction,
+    "touch/three-fingers-and-pinch.trace": touch_three_fingers_and_pinch,
+    "touch/two-and-one-finger.trace": touch_two_and_one_finger,
+    "touchpad-jitter/session.trace": touchpad_jitter_session,
+    "touchscreen-jitter/session.trace": touchscreen_jitter_session,
+    "hold/one-finger.trace": hold_one_finger,
+    "hold/two-fingers.trace": hold_two_fingers,
+}
+
+if __name__ == "__main__":
+    corpus = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                          "traces")
+    for name, scenario in TRACES.items():
+        scenario().write(os.path.join(corpus, name))
@@ -0,0 +1,132 @@
+/*
+    gebaar
+    Copyright (C) 2019   coffee2code
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Stands in for systemd on a datagram socket and checks what the Notifier
+ * sends it: READY=1 with the status, STATUS= on every tick, and WATCHDOG=1
+ * pings that resume right after a stall instead of a period later.
+ */
+
+#include <spdlog/sinks/stdout_sinks.h>
+#include <spdlog/spdlog.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "daemon/notify.h"
+#include "io/loop.h"
+
+#define WATCHDOG_USEC 1000000  // pings every 500 ms
+#define STALL_USEC 1200000     // overruns the first tick
+#define RESUME_MAX_MS 150      // a missed ping must follow the stall sooner
+
+static int failures = 0;
+
+#define CHECK(condition)                                              \
+  do {                                                                \
+    if (!(condition)) {                                               \
+      fprintf(stderr, "%s:%d: %s failed\n", __FILE__, __LINE__,       \
+              #condition);                                            \
+      ++failures;                                                     \
+    }                                                                 \
+  } while (0)
+
+struct message {
+  std::string text;
+  std::chrono::steady_clock::time_point at;
+};
+
+int main() {
+  spdlog::stdout_logger_mt("main");
+
+  char dir[] = "/tmp/gebaard-notify-XXXXXX";
+  if (mkdtemp(dir) == nullptr) {
+    perror("mkdtemp");
+    return EXIT_FAILURE;
+  }
+  std::string path = std::string(dir) + "/notify";
+  struct sockaddr_un address {};
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  int manager = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (manager < 0 ||
+      bind(manager, reinterpret_cast<struct sockaddr*>(&address),
+           sizeof(address)) < 0) {
+    perror("bind");
+    return EXIT_FAILURE;
+  }
+  setenv("NOTIFY_SOCKET", path.c_str(), 1);
+  setenv("WATCHDOG_USEC", std::to_string(WATCHDOG_USEC).c_str(), 1);
+  setenv("WATCHDOG_PID", std::to_string(getpid()).c_str(), 1);
+
+  std::vector<message> received;
+  {
+    gebaar::daemon::Notifier notifier;
+    CHECK(notifier.enabled());
+    CHECK(getenv("NOTIFY_SOCKET") == nullptr);
+    CHECK(getenv("WATCHDOG_USEC") == nullptr);
+
+    gebaar::io::EventLoop loop;
+    loop.watch(manager, [&] {
+      char buffer[512];
+      ssize_t length = recv(manager, buffer, sizeof(buffer), MSG_DONTWAIT);
+      if (length > 0) {
+        received.push_back(
+            {std::string(buffer, length), std::chrono::steady_clock::now()});
+      }
+      // READY, the overrun tick, the ping it owes and the next one
+      if (received.size() == 4) {
+        loop.stop();
+      }
+    });
+    gebaar::io::Timer deadline;
+    loop.watch(deadline.fd(), [&] { loop.stop(); });
+    deadline.arm(5000);
+
+    notifier.ready(loop, [] { return std::string("2 devices"); });
+    usleep(STALL_USEC);
+    loop.run();
+
+    notifier.stopping();
+    char buffer[512];
+    ssize_t length = recv(manager, buffer, sizeof(buffer), MSG_DONTWAIT);
+    CHECK(length > 0 && std::string(buffer, length) == "STOPPING=1");
+  }
+
+  CHECK(received.size() == 4);
+  if (received.size() == 4) {
+    CHECK(received[0].text == "READY=1\nSTATUS=2 devices");
+    CHECK(received[1].text == "STATUS=2 devices");
+    CHECK(received[2].text == "WATCHDOG=1\nSTATUS=2 devices");
+    CHECK(received[3].text == "WATCHDOG=1\nSTATUS=2 devices");
+    CHECK(std::chrono::duration_cast<std::chrono::milliseconds>(
+              received[2].at - received[1].at)
+              .count() < RESUME_MAX_MS);
+  }
+
+  close(manager);
+  unlink(path.c_str());
+  rmdir(dir);
+  spdlog::shutdown();
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}